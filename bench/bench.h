@@ -0,0 +1,61 @@
+#ifndef BENCH_H_
+#define BENCH_H_
+
+#define _DEFAULT_SOURCE
+#define _GNU_SOURCE
+
+#include <glob.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "editor_configs.h"
+
+// the editor's globals live in e.c, which benchmarks don't link against
+struct edConfig E;
+
+static inline double benchNow() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static inline unsigned benchRand(unsigned *seed) {
+  *seed = *seed * 1103515245 + 12345;
+  return (*seed >> 16) & 0x7fff;
+}
+
+static inline void benchWriteSources(const char *path, size_t size, int lines) {
+  // a C file out of the editor's own sources, lib/*.c over and over: whole
+  // files until it has size bytes, or if lines isn't 0, that many lines
+  glob_t g;
+  if (glob("lib/*.c", 0, NULL, &g) != 0) {
+    fprintf(stderr, "run from the repo root\n");
+    exit(1);
+  }
+
+  FILE *out = fopen(path, "w");
+  if (out == NULL) { perror("fopen"); exit(1); }
+  char *line = NULL;
+  size_t cap = 0, done = 0;
+  int n = 0;
+  while (lines ? n < lines : done < size) {
+    size_t i;
+    for (i = 0; i < g.gl_pathc && (lines ? n < lines : done < size); i++) {
+      FILE *in = fopen(g.gl_pathv[i], "r");
+      ssize_t len;
+      while ((lines == 0 || n < lines) && (len = getline(&line, &cap, in)) != -1) {
+        fwrite(line, 1, len, out);
+        done += len;
+        n++;
+      }
+      fclose(in);
+    }
+  }
+  free(line);
+  fclose(out);
+  globfree(&g);
+}
+
+#endif // BENCH_H_
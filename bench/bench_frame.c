@@ -0,0 +1,118 @@
+/*
+** frame rendering cost: draws frames of a synthetic C file on a 300x100
+** terminal (with stdout sent to /dev/null) and reports heap allocations and
+** nanoseconds per frame, for full repaints, scrolling and typing, and for
+** opening/closing a ml comment at the top of the file that nothing below ends.
+**
+** usage: bench_frame [frames]
+*/
+#include "bench.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "editor_ops.h"
+#include "editor_output.h"
+
+// every allocation the editor makes goes through these (see the makefile)
+static long nAllocs;
+void *__real_malloc(size_t n);
+void *__real_realloc(void *p, size_t n);
+void *__wrap_malloc(size_t n) { nAllocs++; return __real_malloc(n); }
+void *__wrap_realloc(void *p, size_t n) { nAllocs++; return __real_realloc(p, n); }
+
+static const char *corpus[] = {
+  "int main(int argc, char *argv[]) {",
+  "  /* walk the arguments and pick out the flags we know about */",
+  "  for (int i = 0; i < argc; i++) {",
+  "    if (strcmp(argv[i], \"-v\") == 0) verbose = 1; // be chatty",
+  "\tstatic double scale = 3.14159 * radius;\tunsigned long mask = 0x7f;",
+  "    while (len > 0 && (buf[len - 1] == '\\n' || buf[len - 1] == '\\r')) len--;",
+  "  }",
+  "  return 0;",
+  "}",
+  "",
+};
+#define CORPUS_LEN (sizeof(corpus) / sizeof(corpus[0]))
+
+static void loadDoc(int nRows) {
+  char line[400];
+  int i;
+  for (i = 0; i < nRows; i++) {
+    // pad some lines out so wide terminals have something to draw
+    const char *s = corpus[i % CORPUS_LEN];
+    int len = snprintf(line, sizeof(line), "%s%s", s, (i % 3 == 0) ? s : "");
+    edInsertRow(E.nRows, line, len);
+  }
+  E.dirty = 0;
+}
+
+static void run(const char *name, int frames, void (*step)(int)) {
+  long allocs = nAllocs;
+  double t0 = benchNow();
+  int i;
+  for (i = 0; i < frames; i++) {
+    step(i);
+    edRefreshScreen();
+  }
+  double t = benchNow() - t0;
+  fprintf(stderr, "%-8s %8.2f allocs/frame %10.0f ns/frame\n", name,
+          (double)(nAllocs - allocs) / frames, t / frames * 1e9);
+}
+
+static void stepRepaint(int i) {
+  (void)i;
+  edScreenInvalidate();
+}
+
+static void stepScroll(int i) {
+  E.cY = E.sRows + i % (E.nRows - E.sRows);
+}
+
+static void stepType(int i) {
+  E.cY = E.sRows / 2;
+  E.cX = 10;
+  if (i % 2) edInsertChar('x');
+  else edRemoveChar();
+}
+
+static void stepComment(int i) {
+  // every row below changes state, but only the ones on screen need redoing
+  E.cY = 0;
+  int j;
+  for (j = 0; j < 3; j++) {
+    if (i % 2) {
+      E.cX = 3 - j;
+      edRemoveChar();
+    } else {
+      E.cX = j;
+      edInsertChar('"');
+    }
+  }
+}
+
+int main(int argc, char *argv[]) {
+  int frames = argc > 1 ? atoi(argv[1]) : 2000;
+
+  edStoreInit(&E.rows);
+  E.sRows = 100;
+  E.sCols = 300;
+  E.fname = "bench.c";
+  edChooseHL();
+  loadDoc(50000);
+
+  // the terminal is /dev/null; results go to stderr
+  int null = open("/dev/null", O_WRONLY);
+  dup2(null, STDOUT_FILENO);
+
+  edRefreshScreen();
+  run("repaint", frames, stepRepaint);
+  run("scroll", frames, stepScroll);
+  run("type", frames, stepType);
+
+  // the corpus closes its own C comments, but nothing in it ends a python one
+  E.fname = "bench.py";
+  edChooseHL();
+  run("comment", frames, stepComment);
+  return 0;
+}
@@ -0,0 +1,51 @@
+/*
+** highlighter throughput: writes a C file of the given size (32 MB by
+** default) out of the editor's own sources, opens it, and times highlighting
+** all of it from scratch in MB/s. once while its rows are still lazy in the
+** mapped file (only the ml comment state is worked out) and once with every
+** row built (full highlighting).
+**
+** usage: bench_hl [size in MB] [path]
+*/
+#include "bench.h"
+
+#include <unistd.h>
+
+#include "file_io.h"
+#include "syntax_highlighting.h"
+
+static double lexAll() {
+  // best of a few runs, each starting from nothing known
+  double best = 0;
+  int rep;
+  for (rep = 0; rep < 3; rep++) {
+    edChooseHL();
+    double t0 = benchNow();
+    edHLEnsure(E.nRows);
+    double t = benchNow() - t0;
+    if (rep == 0 || t < best) best = t;
+  }
+  return best;
+}
+
+int main(int argc, char *argv[]) {
+  size_t mb = argc > 1 ? atol(argv[1]) : 32;
+  char *path = argc > 2 ? argv[2] : "/tmp/bench_hl.c";
+
+  benchWriteSources(path, mb << 20, 0);
+  edStoreInit(&E.rows);
+  E.sRows = 100;
+  E.sCols = 300;
+  edOpen(path);
+
+  double size = E.map.len / 1e6;
+  printf("%.0f MB, %d lines\n", size, E.nRows);
+  printf("lazy  %8.1f MB/s\n", size / lexAll());
+
+  int i;
+  for (i = 0; i < E.nRows; i++) edRowAt(i);
+  printf("built %8.1f MB/s\n", size / lexAll());
+
+  unlink(path);
+  return 0;
+}
@@ -0,0 +1,90 @@
+/*
+** highlighting memory and rendering on a large file: writes a C file of the
+** given size (64 MB by default) out of the editor's own sources, builds and
+** highlights every row, and reports what the highlighting takes as runs
+** against a class byte per char, and how much the process grew. then renders
+** pages from all over the file as full repaints on a 300x100 terminal.
+**
+** usage: bench_hlmem [size in MB] [path]
+*/
+#include "bench.h"
+
+#include <fcntl.h>
+#include <malloc.h>
+#include <unistd.h>
+
+#include "editor_output.h"
+#include "file_io.h"
+
+#define PAGES 2000
+
+static double rssMB() {
+  long pages = 0;
+  FILE *fp = fopen("/proc/self/statm", "r");
+  if (fp) {
+    if (fscanf(fp, "%*d %ld", &pages) != 1) pages = 0;
+    fclose(fp);
+  }
+  return pages * (double)sysconf(_SC_PAGESIZE) / 1e6;
+}
+
+int main(int argc, char *argv[]) {
+  size_t mb = argc > 1 ? atol(argv[1]) : 64;
+  char *path = argc > 2 ? argv[2] : "/tmp/bench_hlmem.c";
+
+  benchWriteSources(path, mb << 20, 0);
+  edStoreInit(&E.rows);
+  E.sRows = 100;
+  E.sCols = 300;
+  edOpen(path);
+
+  double before = rssMB();
+  int i;
+  for (i = 0; i < E.nRows; i++) edRowAt(i);
+  edHLEnsure(E.nRows);
+  double after = rssMB();
+
+  // what the runs take on the heap, and what a byte per char would have
+  size_t runs = 0, runBytes = 0, byteBytes = 0;
+  int plain = 0;
+  for (i = 0; i < E.nRows; i++) {
+    edRow *row = edRowAt(i);
+    void *bytes = malloc(row->size);
+    byteBytes += malloc_usable_size(bytes);
+    free(bytes);
+    if (row->hl == NULL) {
+      plain++;
+      continue;
+    }
+    runs += row->nHL;
+    runBytes += edRowMemCap(sizeof(edHLRun) * row->nHL);
+  }
+
+  printf("%.0f MB, %d lines (%d all plain), %.2f runs per highlighted line\n",
+         E.map.len / 1e6, E.nRows, plain, runs / (double)(E.nRows - plain));
+  printf("hl as runs   %8.1f MB\n", runBytes / 1e6);
+  printf("hl as bytes  %8.1f MB\n", byteBytes / 1e6);
+  printf("rss grew by  %8.1f MB building and highlighting every row\n", after - before);
+
+  // frames go to /dev/null
+  int out = open("/dev/null", O_WRONLY);
+  int saved = dup(STDOUT_FILENO);
+  dup2(out, STDOUT_FILENO);
+
+  unsigned seed = 1;
+  double t = 0;
+  for (i = 0; i < PAGES; i++) {
+    E.cY = (benchRand(&seed) << 15 | benchRand(&seed)) % E.nRows;
+    E.rowOff = E.cY;
+    edScreenInvalidate();
+    double t0 = benchNow();
+    edRefreshScreen();
+    t += benchNow() - t0;
+  }
+
+  dup2(saved, STDOUT_FILENO);
+  printf("render       %8.0f ns/frame over %d pages\n", t / PAGES * 1e9, PAGES);
+
+  unlink(path);
+  return 0;
+}
@@ -0,0 +1,90 @@
+/*
+** line indexing throughput: writes a synthetic log (512 MB by default), maps
+** it, and times edIndexLines against the single-threaded memchr loop it
+** replaced.
+**
+** usage: bench_index [size in MB] [path]
+*/
+#include "bench.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "line_index.h"
+
+#define WRITE_CHUNK (64 << 20)
+
+static void writeFile(const char *path, size_t size) {
+  // lines of 0-159 chars, one in 16 of them ending in \r\n
+  char *buf = malloc(WRITE_CHUNK);
+  unsigned seed = 1;
+  size_t i = 0;
+  while (i < WRITE_CHUNK) {
+    int len = benchRand(&seed) % 160;
+    while (len-- && i < WRITE_CHUNK) buf[i++] = 'a' + benchRand(&seed) % 26;
+    if (i < WRITE_CHUNK && benchRand(&seed) % 16 == 0) buf[i++] = '\r';
+    if (i < WRITE_CHUNK) buf[i++] = '\n';
+  }
+
+  int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd == -1) { perror("open"); exit(1); }
+  size_t done = 0;
+  while (done < size) {
+    size_t n = size - done < WRITE_CHUNK ? size - done : WRITE_CHUNK;
+    if (write(fd, buf, n) != (ssize_t)n) { perror("write"); exit(1); }
+    done += n;
+  }
+  close(fd);
+  free(buf);
+}
+
+static int indexMemchr(const char *b, size_t len) {
+  // the single-threaded loop: one memchr per line, appending to a table
+  size_t cap = 1024, n = 0;
+  size_t *lineOff = malloc(sizeof(size_t) * cap);
+  size_t off = 0;
+  while (off < len) {
+    if (n == cap) lineOff = realloc(lineOff, sizeof(size_t) * (cap *= 2));
+    lineOff[n++] = off;
+
+    const char *nl = memchr(&b[off], '\n', len - off);
+    off = nl ? (size_t)(nl - b) + 1 : len + 1;
+  }
+  free(lineOff);
+  return n;
+}
+
+int main(int argc, char *argv[]) {
+  size_t size = (size_t)(argc > 1 ? atol(argv[1]) : 512) << 20;
+  const char *path = argc > 2 ? argv[2] : "/tmp/bench_index.txt";
+
+  printf("writing %zu MB to %s\n", size >> 20, path);
+  writeFile(path, size);
+
+  int fd = open(path, O_RDONLY);
+  char *b = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (b == MAP_FAILED) { perror("mmap"); return 1; }
+
+  double gb = size / 1e9;
+  double t0 = benchNow();
+  int nBase = indexMemchr(b, size);
+  double tBase = benchNow() - t0;
+  printf("memchr loop:   %d lines, %.3f s, %.2f GB/s\n", nBase, tBase, gb / tBase);
+
+  int pass;
+  for (pass = 0; pass < 3; pass++) {
+    int nLines, hasCR;
+    t0 = benchNow();
+    size_t *lineOff = edIndexLines(b, size, &nLines, &hasCR);
+    double t = benchNow() - t0;
+    printf("edIndexLines:  %d lines, %.3f s, %.2f GB/s (%d threads)\n",
+           nLines, t, gb / t, edPoolSize());
+    free(lineOff);
+  }
+
+  munmap(b, size);
+  unlink(path);
+  return 0;
+}
@@ -0,0 +1,126 @@
+/*
+** journal overhead and recovery: writes a log of the given number of lines
+** (100k by default) and types keys into it (chars, newlines and backspaces,
+** with the cursor hopping around the file) through the calls the editor
+** makes, flushing the journal after every key as edProcessKeys does for a
+** key on its own. that's done once in a child that keeps a journal and then
+** dies without quitting, and once in the parent without one. prints what the
+** journal costs a key, in time and bytes, and how many fsyncs it took. then
+** the parent opens the file again, times recovering the child's edits from
+** the journal, and checks them against its own.
+**
+** usage: bench_journal [lines] [keys]
+*/
+#include "bench.h"
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "dynamic_str.h"
+#include "editor_ops.h"
+#include "file_io.h"
+#include "journal.h"
+
+#define PATH "/tmp/bench_journal.log"
+
+static void writeFile(int lines) {
+  FILE *out = fopen(PATH, "w");
+  if (out == NULL) { perror("fopen"); exit(1); }
+  unsigned seed = 1;
+  int i;
+  for (i = 0; i < lines; i++) {
+    int r = benchRand(&seed);
+    fprintf(out, "2026-10-%02d %02d:%02d worker-%d: request %d took %d ms\n",
+            1 + r % 28, r % 24, (r >> 5) % 60, r % 32, benchRand(&seed),
+            benchRand(&seed) % 1200);
+  }
+  fclose(out);
+}
+
+static double typeKeys(int keys) {
+  // the same keys every time. returns how long they took
+  unsigned seed = 7;
+  double t0 = benchNow();
+  int i;
+  for (i = 0; i < keys; i++) {
+    if (i % 64 == 0) {
+      E.cY = benchRand(&seed) % E.nRows;
+      E.cX = benchRand(&seed) % (edRowAt(E.cY)->size + 1);
+    }
+
+    int r = benchRand(&seed) % 16;
+    if (r == 0) edInsertNewline();
+    else if (r == 1) edRemoveChar();
+    else edInsertChar('a' + r);
+    edJournalFlush();
+  }
+  return benchNow() - t0;
+}
+
+static void allRows(str *db) {
+  dbReset(db);
+  int y;
+  for (y = 0; y < E.nRows; y++) {
+    int len;
+    char *s = edRowChars(y, &len);
+    dbAppend(db, s, len);
+    dbAppendChar(db, '\n');
+  }
+}
+
+int main(int argc, char *argv[]) {
+  int lines = argc > 1 ? atoi(argv[1]) : 100000;
+  int keys = argc > 2 ? atoi(argv[2]) : 200000;
+
+  writeFile(lines);
+  edStoreInit(&E.rows);
+  E.sRows = 100;
+  E.sCols = 300;
+
+  // the child goes first, before the parent has started any threads
+  int fds[2];
+  if (pipe(fds) == -1) { perror("pipe"); exit(1); }
+  pid_t pid = fork();
+  if (pid == 0) {
+    edOpen(PATH);
+    edJournalStart();
+    double res[3];
+    res[0] = typeKeys(keys);
+    res[1] = edJournalSize();
+    res[2] = edJournalSyncs();
+    write(fds[1], res, sizeof(res));
+    _exit(0); // a crash, as far as the journal can tell
+  }
+  double res[3];
+  if (pid == -1 || read(fds[0], res, sizeof(res)) != sizeof(res)) {
+    fprintf(stderr, "the child didn't report back\n");
+    exit(1);
+  }
+  waitpid(pid, NULL, 0);
+
+  edOpen(PATH);
+  double t = typeKeys(keys);
+  str want = ABUF_INIT;
+  allRows(&want);
+  edClose();
+
+  printf("%d lines, %d keys\n", lines, keys);
+  printf("no journal   %8.0f ns/key\n", t / keys * 1e9);
+  printf("journal      %8.0f ns/key, %.1f bytes/key, %.0f fsyncs while typing\n",
+         res[0] / keys * 1e9, res[1] / keys, res[2]);
+
+  edOpen(PATH);
+  double t0 = benchNow();
+  edJournalStart();
+  double rec = benchNow() - t0;
+
+  str got = ABUF_INIT;
+  allRows(&got);
+  int ok = got.len == want.len && memcmp(got.b, want.b, want.len) == 0;
+  printf("recovery     %8.2f ms for %.0f KB of journal (%s), rows %s\n", rec * 1e3,
+         res[1] / 1024, E.smsg, ok ? "ok" : "WRONG");
+
+  edClose(); // and the journal goes with it
+  unlink(PATH);
+  return 0;
+}
@@ -0,0 +1,72 @@
+/*
+** keystroke-to-paint latency while a file re-highlights in the background:
+** opens a C file of the given number of lines (500k by default) as plain
+** text, switches it over to C highlighting like a save-as would, and then
+** types into the middle of it every few ms until the hl worker is done. each
+** keystroke is timed from taking the document lock to the frame being
+** written (stdout goes to /dev/null).
+**
+** usage: bench_latency [lines] [ms between keys]
+*/
+#include "bench.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "editor_ops.h"
+#include "editor_output.h"
+#include "file_io.h"
+#include "syntax_highlighting.h"
+
+#define PATH "/tmp/bench_latency.txt"
+
+int main(int argc, char *argv[]) {
+  int lines = argc > 1 ? atoi(argv[1]) : 500000;
+  int gap = argc > 2 ? atoi(argv[2]) : 5;
+
+  benchWriteSources(PATH, 0, lines);
+  edStoreInit(&E.rows);
+  E.sRows = 100;
+  E.sCols = 300;
+  edOpen(PATH);
+  edHLStart();
+
+  int null = open("/dev/null", O_WRONLY);
+  dup2(null, STDOUT_FILENO);
+
+  E.cY = E.nRows / 2;
+  edRefreshScreen();
+
+  // a new name with another file type highlights the whole file again
+  free(E.fname);
+  E.fname = strdup("bench_latency.c");
+  edChooseHL();
+
+  double start = benchNow();
+  double worst = 0, total = 0;
+  int keys = 0;
+  while (E.hlValid < E.nRows) {
+    // what edReadKey does while it waits on the user
+    edHLKick();
+    pthread_mutex_unlock(&E.lock);
+    usleep(gap * 1000);
+
+    double t0 = benchNow();
+    pthread_mutex_lock(&E.lock);
+    if (keys % 2) edRemoveChar();
+    else edInsertChar('x');
+    edRefreshScreen();
+    double t = benchNow() - t0;
+
+    total += t;
+    if (t > worst) worst = t;
+    keys++;
+  }
+  double done = benchNow() - start;
+
+  unlink(PATH);
+  fprintf(stderr, "%d lines re-highlighted in %.0f ms, %d keys: "
+          "%.0f us average, %.0f us worst\n",
+          E.nRows, done * 1e3, keys, total / keys * 1e6, worst * 1e6);
+  return 0;
+}
@@ -0,0 +1,201 @@
+/*
+** pasting: feeds keys through a pipe standing in for the terminal, the way
+** a paste comes in, and times edProcessKeys taking them in with frames drawn
+** in between, like the main loop does. once as a single line of the given
+** size (256 KB by default), and twice as 50k lines of the editor's own
+** sources: as typed, and as a bracketed paste. the file pasted into is C, so
+** it's all highlighted. then the same number of arrow keys, each an escape
+** sequence, moving down the file, and 250 pages down at the rate of a key
+** held down. prints the frames drawn, the keys that went without one, and
+** what the frames wrote out.
+**
+** usage: bench_paste [KB] [lines]
+*/
+#include "bench.h"
+
+#include <fcntl.h>
+#include <glob.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include "editor_input.h"
+#include "editor_output.h"
+#include "file_io.h"
+#include "syntax_highlighting.h"
+
+#define PATH "/tmp/bench_paste.c"
+
+typedef struct pasteJob {
+  int fd;
+  const char *s;
+  size_t len;
+  size_t step; // bytes per write, gap us apart (0 for all at once)
+  int gap;
+} pasteJob;
+
+static void *writer(void *arg) {
+  pasteJob *job = arg;
+  size_t done = 0;
+  while (done < job->len) {
+    size_t len = job->len - done;
+    if (job->step && len > job->step) len = job->step;
+    ssize_t n = write(job->fd, &job->s[done], len);
+    if (n <= 0) break;
+    done += n;
+    if (job->gap) usleep(job->gap);
+  }
+  close(job->fd);
+  return NULL;
+}
+
+static void feed(const char *name, pasteJob job, int wantY, int wantX) {
+  // job through the pipe, until the cursor ends up at wantY, wantX
+  int fds[2];
+  if (pipe(fds) == -1) { perror("pipe"); exit(1); }
+  dup2(fds[0], STDIN_FILENO);
+  close(fds[0]);
+  job.fd = fds[1];
+  size_t len = job.len;
+
+  int null = open("/dev/null", O_WRONLY);
+  int saved = dup(STDOUT_FILENO);
+  dup2(null, STDOUT_FILENO);
+
+  edFrameStats before = E.frames;
+  double t0 = benchNow();
+  pthread_t w;
+  pthread_create(&w, NULL, writer, &job);
+  while (E.cY != wantY || E.cX != wantX) {
+    edProcessKeys();
+    edRefreshScreen();
+  }
+  double t = benchNow() - t0;
+  pthread_join(w, NULL);
+
+  dup2(saved, STDOUT_FILENO);
+  close(null);
+  close(saved);
+  printf("%-10s %8.1f KB %10.1f ms %8.1f MB/s  %ld frames, %ld skipped, %ld KB out\n",
+         name, len / 1e3, t * 1e3, len / 1e6 / t, E.frames.rendered - before.rendered,
+         E.frames.skipped - before.skipped, (E.frames.bytes - before.bytes) >> 10);
+}
+
+static void paste(const char *name, const char *s, size_t len, int bracketed) {
+  // where the cursor ends up once it's all in
+  int wantY = E.cY, wantX = E.cX;
+  size_t i;
+  for (i = 0; i < len; i++) {
+    if (s[i] == '\r') {
+      wantY++;
+      wantX = 0;
+    } else {
+      wantX++;
+    }
+  }
+
+  if (!bracketed) {
+    feed(name, (pasteJob){0, s, len, 0, 0}, wantY, wantX);
+    return;
+  }
+
+  // the same text between the markers a terminal puts around a paste
+  char *b = malloc(len + 12);
+  memcpy(b, "\x1b[200~", 6);
+  memcpy(&b[6], s, len);
+  memcpy(&b[6 + len], "\x1b[201~", 6);
+  feed(name, (pasteJob){0, b, len + 12, 0, 0}, wantY, wantX);
+  free(b);
+}
+
+static void arrows(int n) {
+  // n presses of the down arrow from the top of the file
+  char *s = malloc(n * 3);
+  int i;
+  for (i = 0; i < n; i++) memcpy(&s[i * 3], "\x1b[B", 3);
+  E.cY = 0;
+  E.cX = 0;
+  feed("arrows", (pasteJob){0, s, n * 3, 0, 0}, n, 0);
+  free(s);
+}
+
+static void held(int n) {
+  // PAGE_DOWN held down, repeating every 2 ms: n pages from the top, each
+  // one a screen further down
+  char *s = malloc(n * 4);
+  int i;
+  for (i = 0; i < n; i++) memcpy(&s[i * 4], "\x1b[6~", 4);
+  E.cY = E.cX = E.rowOff = 0;
+  feed("held", (pasteJob){0, s, n * 4, 4, 2000}, E.sRows * (n + 1) - 1, 0);
+  free(s);
+}
+
+static char *sources(int lines, size_t *len) {
+  // lib/*.c back to back until there are enough lines, each ending in '\r'
+  // like a terminal sends
+  glob_t g;
+  if (glob("lib/*.c", 0, NULL, &g) != 0) {
+    fprintf(stderr, "run from the repo root\n");
+    exit(1);
+  }
+
+  size_t cap = 1 << 20;
+  char *s = malloc(cap);
+  *len = 0;
+  int n = 0;
+  while (n < lines) {
+    size_t i;
+    for (i = 0; i < g.gl_pathc && n < lines; i++) {
+      FILE *in = fopen(g.gl_pathv[i], "r");
+      int c;
+      while (n < lines && (c = fgetc(in)) != EOF) {
+        if (*len == cap) s = realloc(s, cap *= 2);
+        if (c == '\n') {
+          c = '\r';
+          n++;
+        }
+        s[(*len)++] = c;
+      }
+      fclose(in);
+    }
+  }
+  globfree(&g);
+  return s;
+}
+
+int main(int argc, char *argv[]) {
+  size_t size = (size_t)(argc > 1 ? atol(argv[1]) : 256) << 10;
+  int lines = argc > 2 ? atoi(argv[2]) : 50000;
+
+  FILE *fp = fopen(PATH, "w");
+  fputs("int main() {\n}\n", fp);
+  fclose(fp);
+
+  edStoreInit(&E.rows);
+  E.sRows = 100;
+  E.sCols = 300;
+  edOpen(PATH);
+  edHLStart();
+
+  // one long line, pasted in front of the closing brace
+  char *line = malloc(size);
+  unsigned seed = 1;
+  size_t i;
+  for (i = 0; i < size; i++) line[i] = (benchRand(&seed) % 9) ? 'a' + i % 26 : ' ';
+  E.cY = 1;
+  E.cX = 0;
+  paste("one line", line, size, 0);
+
+  size_t len;
+  char *src = sources(lines, &len);
+  E.cY = E.nRows;
+  E.cX = 0;
+  paste("typed", src, len, 0);
+  E.cY = E.nRows;
+  E.cX = 0;
+  paste("bracketed", src, len, 1);
+  arrows(lines);
+  held(250);
+
+  unlink(PATH);
+  return 0;
+}
@@ -0,0 +1,111 @@
+/*
+** regex search throughput: writes a synthetic log (2 GB by default), opens
+** it, and times finding every match of a literal word with edFindMatches and
+** then of the same word and a few patterns with edFindRegex, in GB/s. one
+** line in 64 carries a long run of x's for the (x+x+)+y pattern, which takes
+** a backtracking matcher exponential time. then times a.*z|ab on one long
+** line of "abab...", which has a match at every other byte and a.* running
+** on to the end of the line from each of them, at two lengths: the time per
+** byte should stay the same.
+**
+** usage: bench_regex [size in MB] [path]
+*/
+#include "bench.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "file_io.h"
+#include "regex_dfa.h"
+#include "search_index.h"
+
+#define WRITE_CHUNK (64 << 20)
+
+static const char *levels[] = {"INFO", "INFO", "INFO", "DEBUG", "WARN", "ERROR"};
+
+static void writeFile(const char *path, size_t size) {
+  char *buf = malloc(WRITE_CHUNK + 256);
+  unsigned seed = 1;
+  size_t i = 0;
+  while (i < WRITE_CHUNK) {
+    int r = benchRand(&seed);
+    int day = 1 + benchRand(&seed) % 28;
+    int hour = benchRand(&seed) % 24;
+    i += sprintf(&buf[i], "2026-10-%02d %02d:%02d:%02d.%03d [%s] worker-%d: "
+                 "request %d took %d ms (GET /api/v1/items/%d)",
+                 day, hour, r % 60, (r >> 6) % 60, r % 1000, levels[r % 6],
+                 r % 32, benchRand(&seed), benchRand(&seed) % 1200, benchRand(&seed));
+    if (r % 64 == 0) i += sprintf(&buf[i], " %.40s", "xxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxx");
+    buf[i++] = '\n';
+  }
+
+  int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd == -1) { perror("open"); exit(1); }
+  size_t done = 0;
+  while (done < size) {
+    size_t n = size - done < WRITE_CHUNK ? size - done : WRITE_CHUNK;
+    if (write(fd, buf, n) != (ssize_t)n) { perror("write"); exit(1); }
+    done += n;
+  }
+  close(fd);
+  free(buf);
+}
+
+static void run(const char *name, const char *q, int regex) {
+  E.version++; // nothing cached
+  double t0 = benchNow();
+  edMatchList *ml = regex ? edFindRegex(q, NULL) : edFindMatches(q);
+  double t = benchNow() - t0;
+  printf("%-7s %-22s %8.3f s %6.2f GB/s  %d matches%s\n", name, q, t,
+         E.map.len / 1e9 / t, ml->n, ml->full ? " (too many to keep)" : "");
+}
+
+static void countHit(void *arg, int start, int end) {
+  (void)start;
+  (void)end;
+  (*(int *)arg)++;
+}
+
+static void longLine(const char *q, int len) {
+  char *s = malloc(len);
+  int i;
+  for (i = 0; i < len; i++) s[i] = "ab"[i % 2];
+  edRegex *re = edRegexCompile(q, NULL);
+  edDFA *d = edDFANew(re);
+
+  int n = 0;
+  double t0 = benchNow();
+  edRegexEach(d, s, len, countHit, &n);
+  double t = benchNow() - t0;
+  printf("%-7s %-22s %8.3f s %6.2f GB/s  %d matches in a %d KB line\n", "line", q, t,
+         len / 1e9 / t, n, len >> 10);
+
+  edDFAFree(d);
+  edRegexFree(re);
+  free(s);
+}
+
+int main(int argc, char *argv[]) {
+  size_t size = (size_t)(argc > 1 ? atol(argv[1]) : 2048) << 20;
+  char *path = argc > 2 ? argv[2] : "/tmp/bench_regex.log";
+
+  printf("writing %zu MB to %s\n", size >> 20, path);
+  writeFile(path, size);
+  edStoreInit(&E.rows);
+  E.sRows = 100;
+  E.sCols = 300;
+  edOpen(path);
+  printf("%d lines, %d threads\n", E.nRows, edPoolSize());
+
+  run("literal", "ERROR] worker-7:", 0);
+  run("regex", "ERROR] worker-7:", 1);
+  run("regex", "took [0-9]{4} ms", 1);
+  run("regex", "(WARN|ERROR)] worker-1\\d", 1);
+  run("regex", "^2026-10-0[1-3] 23:", 1);
+  run("regex", "(x+x+)+y", 1);
+  longLine("a.*z|ab", 1 << 20);
+  longLine("a.*z|ab", 8 << 20);
+
+  unlink(path);
+  return 0;
+}
@@ -0,0 +1,101 @@
+/*
+** highlighted rendering cost: opens each source file, renders every page of
+** it as a full repaint on a 300x100 terminal (stdout goes to /dev/null) and
+** reports time and bytes per frame and time per cell.
+**
+** usage: bench_render [file ...]
+** with no files, renders the editor's own sources and a generated python module.
+*/
+#include "bench.h"
+
+#include <fcntl.h>
+#include <glob.h>
+#include <unistd.h>
+
+#include "editor_output.h"
+#include "file_io.h"
+
+#define PY_PATH "/tmp/bench_render.py"
+
+static const char *pySource =
+  "import os\n"
+  "from collections import defaultdict\n"
+  "\n"
+  "class Index(object):\n"
+  "    \"\"\"maps each word to the lines it shows up on\"\"\"\n"
+  "    def __init__(self, path, limit=4096):\n"
+  "        self.path = path  # where the corpus lives\n"
+  "        self.limit = limit * 2.5\n"
+  "        self.words = defaultdict(list)\n"
+  "\n"
+  "    def build(self):\n"
+  "        for n, line in enumerate(open(self.path)):\n"
+  "            if not line.strip() or line.startswith('#'):\n"
+  "                continue\n"
+  "            for w in line.split():\n"
+  "                self.words[w].append(n)\n"
+  "        return len(self.words) > 0 and True or None\n"
+  "\n";
+
+static void writePy() {
+  FILE *fp = fopen(PY_PATH, "w");
+  int i;
+  for (i = 0; i < 200; i++) fputs(pySource, fp);
+  fclose(fp);
+}
+
+static void renderFile(char *path, long *frames, long *bytes, double *t) {
+  // a fresh document for every file
+  edClose();
+  edOpen(path);
+
+  int page;
+  for (page = 0; page * E.sRows < E.nRows; page++) {
+    E.cY = page * E.sRows;
+    E.rowOff = E.cY;
+    edRefreshScreen(); // build the rows outside of the timing
+
+    edScreenInvalidate();
+    off_t before = lseek(STDOUT_FILENO, 0, SEEK_CUR);
+    double t0 = benchNow();
+    edRefreshScreen();
+    *t += benchNow() - t0;
+    *bytes += lseek(STDOUT_FILENO, 0, SEEK_CUR) - before;
+    (*frames)++;
+  }
+}
+
+int main(int argc, char *argv[]) {
+  E.sRows = 100;
+  E.sCols = 300;
+
+  glob_t g;
+  g.gl_pathc = 0;
+  char **files = &argv[1];
+  int nFiles = argc - 1;
+  if (nFiles == 0) {
+    writePy();
+    glob("lib/*.c", 0, NULL, &g);
+    glob(PY_PATH, GLOB_APPEND, NULL, &g);
+    files = g.gl_pathv;
+    nFiles = g.gl_pathc;
+  }
+
+  // frames go to a scratch file so their size can be measured
+  int out = open("/tmp/bench_render.out", O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  int saved = dup(STDOUT_FILENO);
+  dup2(out, STDOUT_FILENO);
+
+  long frames = 0, bytes = 0;
+  double t = 0;
+  int rep, i;
+  for (rep = 0; rep < 20; rep++)
+    for (i = 0; i < nFiles; i++) renderFile(files[i], &frames, &bytes, &t);
+
+  dup2(saved, STDOUT_FILENO);
+  unlink("/tmp/bench_render.out");
+  printf("%d files, %ld frames: %.0f ns/frame, %.2f ns/cell, %ld bytes/frame\n",
+         nFiles, frames, t / frames * 1e9, t / frames * 1e9 / (E.sRows * E.sCols),
+         bytes / frames);
+  return 0;
+}
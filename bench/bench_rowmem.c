@@ -0,0 +1,82 @@
+/*
+** row memory: writes a C file of the given number of lines (1M by default)
+** out of the editor's own sources, then opens it, builds and highlights every
+** row and closes it again, a few times over. reports the heap blocks live
+** with every row built, and how long building and closing take.
+**
+** usage: bench_rowmem [lines in thousands] [path]
+*/
+#include "bench.h"
+
+#include <unistd.h>
+
+#include "file_io.h"
+#include "syntax_highlighting.h"
+
+#define REPS 3
+
+// every heap block is counted on its way through to glibc's allocator
+void *__libc_malloc(size_t n);
+void *__libc_calloc(size_t n, size_t size);
+void *__libc_realloc(void *p, size_t n);
+void __libc_free(void *p);
+
+static long blocks = 0;
+
+void *malloc(size_t n) {
+  void *p = __libc_malloc(n);
+  if (p) __atomic_add_fetch(&blocks, 1, __ATOMIC_RELAXED);
+  return p;
+}
+
+void *calloc(size_t n, size_t size) {
+  void *p = __libc_calloc(n, size);
+  if (p) __atomic_add_fetch(&blocks, 1, __ATOMIC_RELAXED);
+  return p;
+}
+
+void *realloc(void *p, size_t n) {
+  void *q = __libc_realloc(p, n);
+  if (p == NULL && q) __atomic_add_fetch(&blocks, 1, __ATOMIC_RELAXED);
+  if (p && n == 0) __atomic_sub_fetch(&blocks, 1, __ATOMIC_RELAXED);
+  return q;
+}
+
+void free(void *p) {
+  if (p) __atomic_sub_fetch(&blocks, 1, __ATOMIC_RELAXED);
+  __libc_free(p);
+}
+
+int main(int argc, char *argv[]) {
+  int lines = (argc > 1 ? atoi(argv[1]) : 1000) * 1000;
+  char *path = argc > 2 ? argv[2] : "/tmp/bench_rowmem.c";
+
+  benchWriteSources(path, 0, lines);
+  edStoreInit(&E.rows);
+  E.sRows = 100;
+  E.sCols = 300;
+
+  double open = 0, close = 0;
+  long live = 0;
+  int rep, i;
+  for (rep = 0; rep < REPS; rep++) {
+    long before = blocks;
+    double t0 = benchNow();
+    edOpen(path);
+    for (i = 0; i < E.nRows; i++) edRowAt(i);
+    edHLEnsure(E.nRows);
+    double t1 = benchNow();
+    live = blocks - before;
+
+    edClose();
+    open += t1 - t0;
+    close += benchNow() - t1;
+  }
+
+  printf("%d lines: %ld heap blocks live with every row built\n", lines, live);
+  printf("open  %8.1f ms (building and highlighting every row)\n", open / REPS * 1e3);
+  printf("close %8.1f ms\n", close / REPS * 1e3);
+
+  unlink(path);
+  return 0;
+}
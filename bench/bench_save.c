@@ -0,0 +1,173 @@
+/*
+** saving: writes a synthetic log (2.2 GB by default, past what an int
+** holds), opens it, edits a row every 64k so some blocks are built and the
+** rest stay lazy, and saves it. times how long edSave holds up the editor,
+** then keeps editing rows all over the file while the save goes on, the way
+** typing would (the lock is let go between keys), and times those edits.
+** prints how much the peak RSS grew, and checks the saved file against what
+** the document was when the save started.
+**
+** then starts a journal, as the editor does, and saves again three times,
+** checking the file against the document each time: with nothing more
+** changed (a whole save, since the first one ended with edits it didn't
+** have), after adding notes at the end, which only adds them to the file,
+** and after editing a row near the end, which is a whole save again.
+**
+** usage: bench_save [size in MB] [path]
+*/
+#include "bench.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "file_io.h"
+#include "journal.h"
+#include "syntax_highlighting.h"
+
+#define WRITE_CHUNK (64 << 20)
+#define EDIT_EVERY (64 << 10)
+#define SAVE_KEYS 500
+#define NOTES 1000
+
+static void writeFile(const char *path, size_t size) {
+  char *buf = malloc(WRITE_CHUNK + 256);
+  unsigned seed = 1;
+  size_t i = 0;
+  while (i < WRITE_CHUNK) {
+    int r = benchRand(&seed);
+    i += sprintf(&buf[i], "2026-10-%02d %02d:%02d worker-%d: request %d took %d ms",
+                 1 + r % 28, r % 24, (r >> 5) % 60, r % 32, benchRand(&seed),
+                 benchRand(&seed) % 1200);
+    buf[i++] = '\n';
+  }
+
+  int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd == -1) { perror("open"); exit(1); }
+  size_t done = 0;
+  while (done < size) {
+    size_t n = size - done < WRITE_CHUNK ? size - done : WRITE_CHUNK;
+    if (write(fd, buf, n) != (ssize_t)n) { perror("write"); exit(1); }
+    done += n;
+  }
+  close(fd);
+  free(buf);
+}
+
+static long peakKB() {
+  // VmHWM, the most this process has had resident
+  FILE *fp = fopen("/proc/self/status", "r");
+  char line[256];
+  long kb = 0;
+  while (fgets(line, sizeof(line), fp))
+    if (sscanf(line, "VmHWM: %ld", &kb) == 1) break;
+  fclose(fp);
+  return kb;
+}
+
+static int check(const char *path, size_t size) {
+  // the saved file is the old one with an 'X' in front of every edited row
+  // and a newline after the last one
+  FILE *a = fopen(path, "r");
+  int y = 0, bol = 1, c;
+  size_t i = 0;
+  while ((c = getc_unlocked(a)) != EOF) {
+    int want;
+    if (bol && y % EDIT_EVERY == 0) want = 'X';
+    else if (i < size) want = (unsigned char)E.map.b[i++];
+    else want = '\n';
+    if (c != want) break;
+
+    bol = (c == '\n');
+    if (bol) y++;
+  }
+  fclose(a);
+  return c == EOF && i == size;
+}
+
+static int matches(const char *path) {
+  // the file is every row of the document and its newline
+  FILE *a = fopen(path, "r");
+  char *line = NULL;
+  size_t cap = 0;
+  ssize_t n;
+  int y = 0;
+  while ((n = getline(&line, &cap, a)) > 0 && y < E.nRows) {
+    int len;
+    char *s = edRowChars(y++, &len);
+    if (n != len + 1 || memcmp(line, s, len) != 0 || line[len] != '\n') break;
+  }
+  fclose(a);
+  free(line);
+  return n == -1 && y == E.nRows;
+}
+
+static void saveAgain(const char *what, const char *path) {
+  double t0 = benchNow();
+  edSave();
+  edSaveWait();
+  double t = benchNow() - t0;
+  printf("%-16s %8.3f s: %s, %s\n", what, t, E.smsg, matches(path) ? "ok" : "WRONG");
+}
+
+int main(int argc, char *argv[]) {
+  size_t size = (size_t)(argc > 1 ? atol(argv[1]) : 2200) << 20;
+  char *path = argc > 2 ? argv[2] : "/tmp/bench_save.log";
+
+  printf("writing %zu MB to %s\n", size >> 20, path);
+  writeFile(path, size);
+  edStoreInit(&E.rows);
+  E.sRows = 100;
+  E.sCols = 300;
+  edOpen(path);
+  edHLStart();
+
+  int y;
+  for (y = 0; y < E.nRows; y += EDIT_EVERY) edRowInsertChar(edRowAt(y), 0, 'X');
+  printf("%d lines, %d edited\n", E.nRows, (E.nRows + EDIT_EVERY - 1) / EDIT_EVERY);
+
+  long peak = peakKB();
+  double t0 = benchNow();
+  edSave();
+  double held = benchNow() - t0;
+
+  // a key every ms, each in a different block, while it saves
+  unsigned seed = 1;
+  double worst = 0, total = 0;
+  int keys;
+  for (keys = 0; keys < SAVE_KEYS; keys++) {
+    pthread_mutex_unlock(&E.lock);
+    usleep(1000);
+    pthread_mutex_lock(&E.lock);
+
+    double k0 = benchNow();
+    edRowInsertChar(edRowAt(benchRand(&seed) % E.nRows), 0, 'Y');
+    double k = benchNow() - k0;
+    total += k;
+    if (k > worst) worst = k;
+  }
+  edSaveWait();
+  double t = benchNow() - t0;
+
+  printf("save %8.3f s %6.2f GB/s, edSave held the editor %.3f ms: %s\n", t,
+         size / 1e9 / t, held * 1e3, E.smsg);
+  printf("%d edits while saving: %.0f us average, %.0f us worst; peak RSS +%ld MB, %s\n",
+         keys, total / keys * 1e6, worst * 1e6, (peakKB() - peak) >> 10,
+         E.dirty ? "still dirty" : "not dirty");
+
+  // the old file is still mapped, and is what the new one is checked against
+  printf("saved file %s\n", check(path, size) ? "ok" : "WRONG");
+
+  edJournalStart();
+  saveAgain("unchanged", path);
+  for (y = 0; y < NOTES; y++) {
+    char note[64];
+    int len = sprintf(note, "note %d: looked into it", y);
+    edInsertRow(E.nRows, note, len);
+  }
+  saveAgain("notes appended", path);
+  edRowInsertChar(edRowAt(E.nRows - NOTES - 10), 0, 'Z');
+  saveAgain("near the end", path);
+  edJournalStop();
+  unlink(path);
+  return 0;
+}
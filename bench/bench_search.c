@@ -0,0 +1,86 @@
+/*
+** search cost: writes a C file of the given size (64 MB by default) out of
+** the editor's own sources, opens it, and times typing a query one char at a
+** time, both with edFindMatches and with the strstr-per-row loop it replaced
+** (for a query with no match, the worst case for both). then times stepping
+** through the matches of a common query.
+**
+** usage: bench_search [size in MB] [path]
+*/
+#include "bench.h"
+
+#include <unistd.h>
+
+#include "file_io.h"
+#include "search_index.h"
+
+static int oldSearch(const char *q) {
+  // what edSearchCallback did for each key: strstr every row until a match
+  int i;
+  for (i = 0; i < E.nRows; i++) {
+    edRow *row = edRowAt(i);
+    if (strstr(row->chars, q)) return i;
+  }
+  return -1;
+}
+
+static void typeQuery(const char *q) {
+  char typed[64];
+  int len = strlen(q);
+  int i;
+
+  double t0 = benchNow();
+  for (i = 1; i <= len; i++) {
+    memcpy(typed, q, i);
+    typed[i] = '\0';
+    oldSearch(typed);
+  }
+  double old = benchNow() - t0;
+
+  // edRowAt built every row above; start the new one from nothing cached
+  E.version++;
+  t0 = benchNow();
+  int n = 0;
+  for (i = 1; i <= len; i++) {
+    memcpy(typed, q, i);
+    typed[i] = '\0';
+    n = edFindMatches(typed)->n;
+  }
+  double t = benchNow() - t0;
+
+  printf("typing %-16s %8.2f ms/key strstr %8.2f ms/key indexed (%d matches)\n",
+         q, old / len * 1e3, t / len * 1e3, n);
+}
+
+int main(int argc, char *argv[]) {
+  size_t mb = argc > 1 ? atol(argv[1]) : 64;
+  char *path = argc > 2 ? argv[2] : "/tmp/bench_search.c";
+
+  benchWriteSources(path, mb << 20, 0);
+  edStoreInit(&E.rows);
+  E.sRows = 100;
+  E.sCols = 300;
+  edOpen(path);
+  printf("%.0f MB, %d lines, %d threads\n", E.map.len / 1e6, E.nRows, edPoolSize());
+
+  // lazy rows: searched straight out of the mapped file
+  E.version++;
+  double t0 = benchNow();
+  edFindMatches("no such thing");
+  printf("first search %8.2f ms (rows still lazy)\n", (benchNow() - t0) * 1e3);
+
+  typeQuery("no such thing");
+  typeQuery("edRowAt(");
+
+  edMatchList *ml = edFindMatches("E.");
+  edMatch m = {0, -1, 0};
+  int steps = ml->n < 1000000 ? ml->n : 1000000;
+  int i;
+  t0 = benchNow();
+  for (i = 0; i < steps; i++) edNextMatch(ml, m.row, m.col, 1, &m);
+  printf("next match   %8.0f ns/step over %d matches\n",
+         (benchNow() - t0) / steps * 1e9, ml->n);
+
+  unlink(path);
+  return 0;
+}
@@ -0,0 +1,157 @@
+/*
+** undo: writes a log of the given number of lines (100k by default) and
+** types into it the way the editor does, each key opening its undo group
+** first. times undoing and redoing a burst of typing (10k chars by default),
+** which is one group, and checks the row comes back as it was each time.
+** then types keys all over the file (chars, backspaces, newlines and short
+** pastes) and prints what the log takes per key, and what undoing all of it
+** takes per group, checking that leaves the file as it was opened. last,
+** does that again with the log capped, to show it stays under the cap.
+**
+** usage: bench_undo [lines] [burst]
+*/
+#include "bench.h"
+
+#include <unistd.h>
+
+#include "editor_ops.h"
+#include "file_io.h"
+#include "undo.h"
+
+#define PATH "/tmp/bench_undo.log"
+#define KEYS 200000
+#define CAP (1 << 20)
+
+static void writeFile(int lines) {
+  FILE *out = fopen(PATH, "w");
+  if (out == NULL) { perror("fopen"); exit(1); }
+  unsigned seed = 1;
+  int i;
+  for (i = 0; i < lines; i++) {
+    int r = benchRand(&seed);
+    fprintf(out, "2026-10-%02d %02d:%02d worker-%d: request %d took %d ms\n",
+            1 + r % 28, r % 24, (r >> 5) % 60, r % 32, benchRand(&seed),
+            benchRand(&seed) % 1200);
+  }
+  fclose(out);
+}
+
+static int typeKeys(int keys) {
+  // keys all over the file. returns how many groups they made
+  unsigned seed = 7;
+  int groups = 0;
+  int last = -1;
+  int i;
+  for (i = 0; i < keys; i++) {
+    if (i % 64 == 0) {
+      edUndoGroup(UNDO_OTHER);
+      E.cY = benchRand(&seed) % E.nRows;
+      E.cX = benchRand(&seed) % (edRowAt(E.cY)->size + 1);
+      last = -1;
+    }
+
+    int r = benchRand(&seed) % 32;
+    int kind = r < 3 ? UNDO_ERASING : r < 5 ? UNDO_OTHER : UNDO_TYPING;
+    edUndoGroup(kind);
+    if (kind != last || kind == UNDO_OTHER) groups++;
+    last = kind;
+
+    if (r < 3) edRemoveChar();
+    else if (r == 3) edInsertNewline();
+    else if (r == 4) edInsertText("pasted\nlines\n", 13);
+    else edInsertChar('a' + r);
+  }
+  edUndoGroup(UNDO_OTHER);
+  return groups;
+}
+
+static int undoAll() {
+  // how many groups there were to undo
+  int n = 0;
+  while (edUndo()) n++;
+  return n;
+}
+
+static int asOpened() {
+  // every row is the line of the file it was opened as
+  if (E.nRows != E.map.nLines) return 0;
+  int y;
+  for (y = 0; y < E.nRows; y++) {
+    int len;
+    char *s = edRowChars(y, &len);
+    size_t off = E.map.lineOff[y];
+    if ((size_t)len + 1 != E.map.lineOff[y + 1] - off || memcmp(s, &E.map.b[off], len) != 0)
+      return 0;
+  }
+  return 1;
+}
+
+int main(int argc, char *argv[]) {
+  int lines = argc > 1 ? atoi(argv[1]) : 100000;
+  int burst = argc > 2 ? atoi(argv[2]) : 10000;
+
+  writeFile(lines);
+  edStoreInit(&E.rows);
+  E.sRows = 100;
+  E.sCols = 300;
+  edOpen(PATH);
+
+  // a burst of typing in the middle of a row is one group, and one record
+  E.cY = lines / 2;
+  E.cX = 10;
+  int len;
+  char *s = edRowChars(E.cY, &len);
+  char *before = strndup(s, len);
+  int i;
+  for (i = 0; i < burst; i++) {
+    edUndoGroup(UNDO_TYPING);
+    edInsertChar('a' + i % 26);
+  }
+  edUndoGroup(UNDO_OTHER);
+  char *after = strndup(edRowAt(E.cY)->chars, edRowAt(E.cY)->size);
+  size_t size = edUndoSize();
+
+  double t0 = benchNow();
+  edUndo();
+  double undo = benchNow() - t0;
+  int ok = strcmp(edRowAt(E.cY)->chars, before) == 0 && E.cX == 10;
+
+  t0 = benchNow();
+  edRedo();
+  double redo = benchNow() - t0;
+  ok = ok && strcmp(edRowAt(E.cY)->chars, after) == 0 && E.cX == 10 + burst;
+
+  printf("%d lines, %.0f MB\n", lines, E.map.len / 1e6);
+  printf("burst of %d chars: log %zu bytes, undo %.3f ms, redo %.3f ms, %s\n", burst,
+         size, undo * 1e3, redo * 1e3, ok ? "ok" : "WRONG");
+
+  // keys all over the file, and then all of them undone
+  edUndo();
+  edUndoClear();
+  t0 = benchNow();
+  int groups = typeKeys(KEYS);
+  double typed = benchNow() - t0;
+  size = edUndoSize();
+  t0 = benchNow();
+  int undone = undoAll();
+  double all = benchNow() - t0;
+  printf("%d keys in %d groups: %.0f ns/key, log %.1f bytes/key (%zu KB); "
+         "undoing them %.2f us/group (%d groups), %s\n",
+         KEYS, groups, typed / KEYS * 1e9, (double)size / KEYS, size >> 10,
+         all / undone * 1e6, undone, asOpened() ? "ok" : "WRONG");
+
+  // the same again, capped
+  edUndoClear();
+  edUndoSetMax(CAP);
+  typeKeys(KEYS);
+  size = edUndoSize();
+  undone = undoAll();
+  printf("capped at %d KB: log %zu KB, the last %d groups kept\n", CAP >> 10, size >> 10,
+         undone);
+
+  free(before);
+  free(after);
+  edClose();
+  unlink(PATH);
+  return 0;
+}
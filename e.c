@@ -1,5 +1,7 @@
 #include "editor_configs.h"
 #include "file_io.h"
+#include "journal.h"
+#include "syntax_highlighting.h"
 #include "terminal_config.h"
 
 /*** globals ***/
@@ -15,9 +17,23 @@ void init_editor() {
   E.rowOff = 0;
   E.colOff = 0;
   E.dirty = 0;
-  E.row = NULL;
+  E.version = 0;
+  edStoreInit(&E.rows);
+  E.hlValid = 0;
+  E.hlKnown = 0;
+  E.hlBreak = 0;
+  E.hlVersion = 0;
+  E.map.b = NULL;
+  E.screen.front = NULL;
+  E.screen.frontHl = NULL;
+  E.screen.back = NULL;
+  E.screen.backHl = NULL;
+  E.frames.rendered = 0;
+  E.frames.skipped = 0;
+  E.frames.bytes = 0;
   E.fname = NULL;
   E.syntax = NULL;
+  E.search = NULL;
   E.smsg[0] = '\0';
   E.smsgTime = 0;
 
@@ -34,12 +50,16 @@ int main(int argc, char* argv[]) {
   if (argc >= 2) {
     edOpen(argv[1]);
   }
+  edHLStart();
 
-  edSetSMessage("CTRL-S to save | CTRL-Q to quit | CTRL-F to search");
+  edSetSMessage("CTRL-S to save | CTRL-Q to quit | CTRL-F to search | CTRL-R regex");
+
+  // edits a crash lost are put back, over the file they were made to
+  edJournalStart();
 
   while (1) {
     edRefreshScreen();
-    edProcessStroke();
+    edProcessKeys();
   }
   return 0;
 }
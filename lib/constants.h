@@ -3,12 +3,15 @@
 
 /*** defines ***/
 #define CTRL_KEY(k) ((k) & 0x1f)
-#define ABUF_INIT {NULL, 0}
+#define ABUF_INIT {NULL, 0, 0}
 #define TAB_STOP 8
 
 #define HL_NUMBERS (1 << 0)
 #define HL_STRINGS (1 << 1)
 
+// or'd into a highlight class to draw a cell in inverse video
+#define HL_INVERSE 0x80
+
 // map for special keys
 enum specialKeys {
 BACKSPACE = 127,
@@ -20,7 +23,9 @@ HOME_KEY,
 END_KEY,
 DEL_KEY,
 PAGE_UP,
-PAGE_DOWN
+PAGE_DOWN,
+PASTE_START, // a bracketed paste follows, see edReadPaste
+PASTE_END
 };
 
 enum highlightVals {
@@ -31,7 +36,8 @@ HL_MCOMMENT,
 HL_KEYWORD1,
 HL_KEYWORD2,
 HL_NUMBER,
-HL_SEARCH
+HL_SEARCH,
+HL_CLASSES // number of classes above
 };
 
 
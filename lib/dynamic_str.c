@@ -1,14 +1,25 @@
 #include "dynamic_str.h"
 
-void dbAppend(str *db, const char *s, int len) {
-  char *new = realloc(db->b, db->len + len);
+int dbGrow(str *db, int len) {
+  // make room for len more bytes, at least doubling so appends stay amortized O(1)
+  int cap = db->cap ? db->cap * 2 : 256;
+  if (cap < db->len + len) cap = db->len + len;
 
-  if (new == NULL) return;
-  memcpy(&new[db->len], s, len);
+  char *new = realloc(db->b, cap);
+  if (new == NULL) return 0;
   db->b = new;
-  db->len += len;
+  db->cap = cap;
+  return 1;
+}
+
+void dbReset(str *db) {
+  // empty the buffer, but hang on to its memory for the next use
+  db->len = 0;
 }
 
 void dbFree(str *db) {
   free(db->b);
+  db->b = NULL;
+  db->len = 0;
+  db->cap = 0;
 }
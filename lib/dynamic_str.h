@@ -8,9 +8,24 @@
 typedef struct dbuf {
   char *b;
   int len;
+  int cap;
 } str;
 
-void dbAppend(str *db, const char *s, int len);
+int dbGrow(str *db, int len);
+void dbReset(str *db);
 void dbFree(str *db);
 
+// appends stay inline so the common case, where the buffer already has
+// room, is a bounds check and a (usually constant-size) memcpy.
+static inline void dbAppend(str *db, const char *s, int len) {
+  if (db->len + len > db->cap && !dbGrow(db, len)) return;
+  memcpy(&db->b[db->len], s, len);
+  db->len += len;
+}
+
+static inline void dbAppendChar(str *db, char c) {
+  if (db->len == db->cap && !dbGrow(db, 1)) return;
+  db->b[db->len++] = c;
+}
+
 #endif // DYNAMIC_STR_H_
@@ -1,10 +1,13 @@
 #ifndef EDITOR_CONFIGS_H_
 #define EDITOR_CONFIGS_H_
 
+#include <pthread.h>
 #include <termios.h>
 #include <time.h>
 
 #include "row.h"
+#include "row_store.h"
+#include "screen.h"
 
 struct edSyntax {
   char *fType;
@@ -14,6 +17,8 @@ struct edSyntax {
   char *mcommentEndToken;
   char **keywords;
   int flags;
+  struct edKeywordTable *kwTable; // keywords, compiled by edChooseHL
+  unsigned char *charClass; // CC_* bits of every byte, also by edChooseHL
 };
 
 struct edConfig {
@@ -25,12 +30,22 @@ struct edConfig {
   int rowOff;
   int colOff;
   int dirty; // is file changed?
+  unsigned int version; // bumped on every change to the text
   char *fname;
   char smsg[80];
   time_t smsgTime;
   struct edSyntax *syntax;
-  edRow *row;
+  int hlValid; // rows before this are highlighted right
+  int hlKnown; // rows from here on were never highlighted at all
+  int hlBreak; // rows before this may have changed since they were
+  unsigned int hlVersion; // bumped whenever rows change under the highlighter
+  struct edMatchList *search; // matches drawn over the text while searching
+  edRowStore rows;
+  edFileMap map;
+  edScreen screen;
+  edFrameStats frames;
   struct termios orig_termios;
+  pthread_mutex_t lock; // guards all of the above against the hl worker
 };
 
 extern struct edConfig E;
@@ -1,7 +1,7 @@
 #include "editor_input.h"
 
 void edMoveCursor(int c) {
-  edRow *row = (E.cY >= E.nRows) ? NULL : &E.row[E.cY];
+  edRow *row = edRowRead(E.cY);
 
   switch (c) {
     case ARROW_LEFT:
@@ -10,7 +10,7 @@ void edMoveCursor(int c) {
       // move to end of previous line
       } else if (E.cY > 0) {
         E.cY--;
-        E.cX = E.row[E.cY].size;
+        E.cX = edRowRead(E.cY)->size;
       }
       break;
     case ARROW_RIGHT:
@@ -36,7 +36,7 @@ void edMoveCursor(int c) {
   }
 
   // snap cursor to end of row if curr. row is shorter than prev. row
-  row = (E.cY >= E.nRows) ? NULL : &E.row[E.cY];
+  row = edRowRead(E.cY);
   int rowLen = row ? row->size : 0;
   if (E.cX > rowLen)
     E.cX = rowLen;
@@ -46,17 +46,25 @@ void edProcessStroke() {
   int c = edReadKey();
   static int confirm_quit = 1;
 
+  // typed chars go into one undo group, and so do backspaces
+  if (edIsTextKey(c)) edUndoGroup(UNDO_TYPING);
+  else if (c == BACKSPACE || c == CTRL_KEY('h') || c == DEL_KEY) edUndoGroup(UNDO_ERASING);
+  else edUndoGroup(UNDO_OTHER);
+
   switch (c) {
     case '\r':
       edInsertNewline();
       break;
 
     case CTRL_KEY('q'):
+      // a save still going is let finish, and then it's known what's unsaved
+      edSaveWait();
       if (E.dirty && confirm_quit) {
         edSetSMessage("File has unsaved changes. Press CTRL-Q again to discard them & quit.");
         confirm_quit = 0;
         return;
       }
+      edJournalStop();
       edClearScreen();
       exit(0);
       break;
@@ -65,17 +73,29 @@ void edProcessStroke() {
       edSearch();
       break;
 
+    case CTRL_KEY('r'):
+      edSearchRegex();
+      break;
+
     case CTRL_KEY('s'):
       edSave();
       break;
 
+    case CTRL_KEY('z'):
+      edUndo();
+      break;
+
+    case CTRL_KEY('y'):
+      edRedo();
+      break;
+
     case HOME_KEY:
       E.cX = 0;
       break;
 
     case END_KEY:
       if (E.cY < E.nRows) {
-        E.cX = E.row[E.cY].size;
+        E.cX = edRowRead(E.cY)->size;
       }
       break;
 
@@ -88,7 +108,10 @@ void edProcessStroke() {
     case PAGE_UP:
     case PAGE_DOWN:
     {
-      //move cursor to top/bottom, then simulate screen's worth of ups/downs
+      //move cursor to top/bottom, then simulate screen's worth of ups/downs.
+      //the view is brought up to date first, as keys since the last frame
+      //may have moved the cursor off it
+      edScroll();
       if (c == PAGE_UP) {
         E.cY = E.rowOff;
       } else if (c == PAGE_DOWN) {
@@ -109,18 +132,62 @@ void edProcessStroke() {
       edMoveCursor(c);
       break;
 
+    case PASTE_START:
+    {
+      // the whole paste goes in at once, with a single repaint after it
+      static str paste = ABUF_INIT;
+      dbReset(&paste);
+      edReadPaste(&paste);
+      edInsertText(paste.b, paste.len);
+      break;
+    }
+
+    case PASTE_END:
     case CTRL_KEY('l'):
     case '\x1b':
       break;
 
     default:
-      edInsertChar(c);
+      if (edIsTextKey(c)) {
+        // the rest of a paste (or of fast typing) is likely waiting already,
+        // and goes in along with c as one span
+        char span[INPUT_BUF];
+        span[0] = c;
+        edInsertSpan(span, 1 + edReadSpan(&span[1], sizeof(span) - 1));
+      } else {
+        edInsertChar(c);
+      }
       break;
   }
 
   confirm_quit = 1; // this goes if any key other than ctrl-q is pressed.
 }
 
+static double frameNow() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+void edProcessKeys() {
+  // takes a key, waiting on it if need be, and then any more that come in
+  // before the next frame is due, FRAME_MS after the one just drawn. a key
+  // after a pause gets its frame right away; keys coming in faster than
+  // that (a key held down, or piled up behind a slow terminal) go in
+  // together between frames instead of each getting one
+  double due = frameNow() + FRAME_MS / 1e3;
+  edProcessStroke();
+
+  double now;
+  while ((now = frameNow()) < due && edKeysPending((due - now) * 1e3)) {
+    edProcessStroke();
+    E.frames.skipped++;
+  }
+
+  // the journal is written once for all of them
+  edJournalFlush();
+}
+
 char *edPrompt(char *prompt, void (*callback)(char *, int)) {
   size_t bSize = 128;
   char *buf = malloc(bSize);
@@ -128,10 +195,12 @@ char *edPrompt(char *prompt, void (*callback)(char *, int)) {
   size_t bLen = 0;
   buf[0] = '\0';
 
+  edSetSMessage(prompt, buf);
   while (1) {
-    // similar control loop to main as we fill out the user's answer to the prompt
-    edSetSMessage(prompt, buf);
-    edRefreshScreen();
+    // similar control loop to main as we fill out the user's answer to the
+    // prompt, drawn once the keys typed ahead are in
+    if (edKeysPending(0)) E.frames.skipped++;
+    else edRefreshScreen();
 
     int c = edReadKey();
     if (c == BACKSPACE || c == DEL_KEY || c == CTRL_KEY('h')) {
@@ -161,7 +230,9 @@ char *edPrompt(char *prompt, void (*callback)(char *, int)) {
       buf[bLen] = '\0';
     }
 
-    // for incremental search (we search as the query is built)
+    // for incremental search (we search as the query is built). what the
+    // callback has to say about the answer is shown in place of the prompt
+    edSetSMessage(prompt, buf);
     if (callback) callback(buf, c);
   }
 }
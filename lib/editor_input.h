@@ -1,6 +1,11 @@
 #ifndef EDITOR_INPUT_H_
 #define EDITOR_INPUT_H_
 
+#ifndef _DEFAULT_SOURCE
+#define _DEFAULT_SOURCE
+#endif
+
+#include <time.h>
 
 #include "constants.h"
 #include "editor_configs.h"
@@ -9,8 +14,13 @@
 #include "file_io.h"
 #include "row.h"
 #include "terminal_config.h"
+#include "undo.h"
+
+// frames are drawn at most this often (about 60 a second)
+#define FRAME_MS 16
 
 void edProcessStroke();
+void edProcessKeys();
 void edMoveCursor(int c);
 char *edPrompt(char *prompt, void (*callback)(char *, int));
 
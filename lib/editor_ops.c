@@ -6,21 +6,60 @@ void edInsertChar(int c) {
     // add a new row if we're at the end
     edInsertRow(E.nRows, "", 0);
   }
-  edRowInsertChar(&E.row[E.cY], E.cX, c);
+  edRowInsertChar(edRowAt(E.cY), E.cX, c);
   E.cX++;
 }
 
+void edInsertSpan(char *s, int len) {
+  if (E.cY == E.nRows) {
+    edInsertRow(E.nRows, "", 0);
+  }
+  edRowInsertStr(edRowAt(E.cY), E.cX, s, len);
+  E.cX += len;
+}
+
+void edInsertText(char *s, int len) {
+  // a paste: its first line goes in at the cursor, the others become rows of
+  // their own, and the rest of the cursor's row ends up after the last one
+  int first = 0;
+  while (first < len && s[first] != '\r' && s[first] != '\n') first++;
+  if (first == len) {
+    if (len) edInsertSpan(s, len);
+    return;
+  }
+
+  if (E.cY == E.nRows) {
+    edInsertRow(E.nRows, "", 0);
+  }
+  edRow *row = edRowAt(E.cY);
+  int tailLen = row->size - E.cX;
+  char *tail = malloc(tailLen + 1);
+  memcpy(tail, &row->chars[E.cX], tailLen);
+  edRowTruncate(row, E.cX);
+  edRowAppendStr(row, s, first);
+
+  int rest = first + 1;
+  if (s[first] == '\r' && rest < len && s[rest] == '\n') rest++;
+  E.cY += edInsertLines(E.cY + 1, &s[rest], len - rest);
+
+  row = edRowAt(E.cY);
+  E.cX = row->size;
+  edRowAppendStr(row, tail, tailLen);
+  free(tail);
+}
+
 void edRemoveChar() {
   if (E.cY == E.nRows) return;
   if (E.cY == 0 && E.cX == 0) return;
 
-  edRow *row = &E.row[E.cY];
+  edRow *row = edRowAt(E.cY);
   if (E.cX > 0) {
     edRowRemoveChar(row, E.cX - 1);
     E.cX--;
   } else {
-    E.cX = E.row[E.cY - 1].size;
-    edRowAppendStr(&E.row[E.cY - 1], row->chars, row->size);
+    edRow *prev = edRowAt(E.cY - 1);
+    E.cX = prev->size;
+    edRowAppendStr(prev, row->chars, row->size);
     edDeleteRow(E.cY);
     E.cY--;
   }
@@ -31,14 +70,12 @@ void edInsertNewline() {
     // when the cursor is at the start, create a row above
     edInsertRow(E.cY, "", 0);
   } else {
-    edRow *row = &E.row[E.cY];
+    edRow *row = edRowAt(E.cY);
 
     // create a row under the current one, with space for all characters to the right
     edInsertRow(E.cY + 1, &row->chars[E.cX], row->size - E.cX);
-    row = &E.row[E.cY]; // reassignment due to the possible realloc memory shuffle
-    row->size = E.cX;
-    row->chars[row->size] = '\0';
-    edUpdateRow(row);
+    row = edRowAt(E.cY); // reassignment since the insert can shift or split the block
+    edRowTruncate(row, E.cX);
   }
   E.cY++;
   E.cX = 0;
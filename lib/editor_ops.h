@@ -8,6 +8,8 @@
 
 
 void edInsertChar(int c);
+void edInsertSpan(char *s, int len);
+void edInsertText(char *s, int len);
 void edRemoveChar();
 void edInsertNewline();
 
@@ -8,93 +8,114 @@ void edClearScreen() {
 
 void edRefreshScreen() {
   edScroll();
-  str db = ABUF_INIT;
 
-  // empty screen and reposition cursor
+  // draw the frame into the back buffer...
+  edScreenResize(E.sRows + 2, E.sCols);
+  edScreenClear();
+  edDrawRows();
+  edStatusBar();
+  edMsgBar();
+
+  // ...and only send the terminal the cells that changed since the last one.
+  // the buffer is kept between frames so it stops allocating once it's big enough
+  static str db = ABUF_INIT;
+  dbReset(&db);
   dbAppend(&db, "\x1b[?25l", 6);
-  dbAppend(&db, "\x1b[H", 3);
-
-  edDrawRows(&db);
-  edStatusBar(&db);
-  edMsgBar(&db);
-
-  // update the cursor position based on keystrokes.
-  char buf[32];
-  snprintf(buf, sizeof(buf), "\x1b[%d;%dH", (E.cY - E.rowOff) + 1, (E.rX - E.colOff) + 1);
-  dbAppend(&db, buf, strlen(buf));
+  edScreenFlush(&db, E.cY - E.rowOff, E.rX - E.colOff);
 
   // hide cursor during repaint to prevent flickering
   dbAppend(&db, "\x1b[?25h", 6);
 
-  // a mere one write to refresh the screen.
-  write(STDOUT_FILENO, db.b, db.len);
-  dbFree(&db);
+  // a mere one write to refresh the screen, if anything changed at all
+  E.frames.rendered++;
+  if (db.len > 12) {
+    write(STDOUT_FILENO, db.b, db.len);
+    E.frames.bytes += db.len;
+  }
 }
 
-void edDrawRows(str *db) {
+void edDrawRows() {
+  // build the rows on screen first, so they're highlighted along with the rest.
+  // that's done here as long as it's quick; rows it doesn't get to are drawn
+  // plain until the background highlighter does
+  int last = E.rowOff + E.sRows;
   int y;
+  for (y = E.rowOff; y < last && y < E.nRows; y++) edRowRead(y);
+  edHLAdvance(last, HL_SYNC_BYTES);
+
+  static edMatch matches[SEARCH_ROW_MATCHES];
+
   for (y = 0; y < E.sRows; y++) {
     // based on the total number of rows in the file, we print '~'.
     // the row offset determines which part of the file we show
     int fRow = y + E.rowOff;
     if (fRow >= E.nRows) {
-      dbAppend(db, "~", 1);
+      edScreenPut(y, 0, '~', HL_NORMAL);
     } else {
-      int len = E.row[fRow].rSize - E.colOff;
-      if (len < 0) len = 0; // user can't go past end of line
-      if (len > E.sCols) len = E.sCols; // user can't go past EOF
-
-      // cutoff the starting part of the string that shouldn't be shown.
-      char *preColor = &E.row[fRow].render[E.colOff];
-      unsigned char *hl = &E.row[fRow].hl[E.colOff];
-      int currColor = -1; // the default, i.e. white-on-black
-      for (int j = 0; j < len; j++) {
-        if (iscntrl(preColor[j])) {
+      edRow *row = edRowRead(fRow);
+      const char *s = row->chars;
+      const edHLRun *hl = (fRow < E.hlValid) ? row->hl : NULL;
+
+      // search matches in this row, drawn over hl
+      int nMatches = E.search ? edRowMatches(E.search, fRow, matches, SEARCH_ROW_MATCHES) : 0;
+      int k = 0;
+
+      // tabs are expanded as they're drawn, starting from the char at colOff.
+      // x is where it goes on screen: left of 0 for a tab cut off by colOff
+      int j = 0;
+      int x = 0;
+      if (E.colOff) {
+        j = edComputeCx(row, E.colOff);
+        x = edComputeRx(row, j) - E.colOff;
+      }
+
+      // hl[r] is the run j is in, and it ends right before runEnd. no runs
+      // is one plain run
+      int r = 0;
+      int runEnd = hl ? HL_RUN_LEN(hl[0]) : row->size;
+      while (j < row->size && x < E.sCols) {
+        while (runEnd <= j) runEnd += HL_RUN_LEN(hl[++r]);
+        while (k < nMatches && matches[k].col + matches[k].len <= j) k++;
+        int inMatch = k < nMatches && matches[k].col <= j;
+        unsigned char cls = inMatch ? HL_SEARCH : hl ? HL_RUN_CLASS(hl[r]) : HL_NORMAL;
+
+        if (s[j] == '\t') {
+          int end = x + TAB_STOP - (x + E.colOff) % TAB_STOP;
+          for (; x < end; x++) edScreenPut(y, x, ' ', cls);
+          j++;
+          continue;
+        }
+
+        if (iscntrl(s[j])) {
           // represent unprintable characters
-          char sym = (preColor[j] <= 26) ? '@' + preColor[j] : '?';
-          dbAppend(db, "\x1b[7m", 4);
-          dbAppend(db, &sym, 1);
-          dbAppend(db, "\x1b[m", 3);
-          if (currColor != -1) {
-            // restore previous highlighting scheme
-            char buf[16];
-            int cLen = snprintf(buf, sizeof(buf), "\x1b[%dm", currColor);
-            dbAppend(db, buf, cLen);
-          }
-        } else if (hl[j] == HL_NORMAL) {
-          if (currColor != -1) {
-            // set current color back to default
-            dbAppend(db, "\x1b[39m", 5);
-            currColor = -1;
-          }
-          dbAppend(db, &preColor[j], 1);
-        } else {
-          int c = edSyntaxToColor(hl[j]);
-          if (c != currColor) {
-            // set current color to new color
-            currColor = c;
-            char buf[16];
-            int clen = snprintf(buf, sizeof(buf), "\x1b[%dm", c);
-            dbAppend(db, buf, clen);
-          }
-          dbAppend(db, &preColor[j], 1);
+          char sym = (s[j] <= 26) ? '@' + s[j] : '?';
+          edScreenPut(y, x++, sym, HL_NORMAL | HL_INVERSE);
+          j++;
+          continue;
         }
-      }
-      // make sure default is back for subsequent rows
-      dbAppend(db, "\x1b[39m", 5);
-    }
 
-    // erase as we go
-    dbAppend(db, "\x1b[K", 3);
+        // copy the printable chars up to the end of the run (or of the match
+        // over it, or up to where the next one starts) at once
+        int stop = inMatch ? row->size : runEnd;
+        if (k < nMatches) {
+          int edge = inMatch ? matches[k].col + matches[k].len : matches[k].col;
+          if (edge < stop) stop = edge;
+        }
+        if (stop > j + E.sCols - x) stop = j + E.sCols - x;
 
-    // add the newline because of the status bar.
-    dbAppend(db, "\r\n", 2);
+        int run = j + 1;
+        while (run < stop && s[run] != '\t' && !iscntrl(s[run])) run++;
+        edScreenPuts(y, x, &s[j], run - j, cls);
+        x += run - j;
+        j = run;
+      }
+    }
   }
 }
 
-void edStatusBar(str *db) {
-  //'7m' switches to inverted colors (white on black), 'm' switches back
-  dbAppend(db, "\x1b[7m", 4);
+void edStatusBar() {
+  // the status bar is drawn in inverted colors (white on black)
+  int y = E.sRows;
   char status[80], rStatus[80];
 
   // fname/total lines
@@ -102,26 +123,24 @@ void edStatusBar(str *db) {
                      E.fname ? E.fname : "[No Name]", E.nRows,
                      E.dirty ? "(modified)" : "");
 
-  // current line
-  int rLen = snprintf(rStatus, sizeof(rStatus), "%s | %d/%d",
-                      E.syntax ? E.syntax->fType : "no ft", E.cY + 1, E.nRows);
+  // undo log size, current line
+  int rLen = snprintf(rStatus, sizeof(rStatus), "%s | undo %zuK | %d/%d",
+                      E.syntax ? E.syntax->fType : "no ft", (edUndoSize() + 1023) / 1024,
+                      E.cY + 1, E.nRows);
 
   if (len > E.sCols) len = E.sCols;
-  dbAppend(db, status, len);
+  edScreenPuts(y, 0, status, len, HL_INVERSE);
 
   while (len < E.sCols) {
     // only put currnet line number if there's space
     if (E.sCols - len == rLen) {
-      dbAppend(db, rStatus, rLen);
+      edScreenPuts(y, len, rStatus, rLen, HL_INVERSE);
       break;
     } else {
-      dbAppend(db, " ", 1);
+      edScreenPut(y, len, ' ', HL_INVERSE);
       len++;
     }
   }
-
-  dbAppend(db, "\x1b[m", 3);
-  dbAppend(db, "\r\n", 2);
 }
 
 void edSetSMessage(const char *fmt, ...) {
@@ -133,12 +152,11 @@ void edSetSMessage(const char *fmt, ...) {
   E.smsgTime = time(NULL);
 }
 
-void edMsgBar(str *db) {
-  dbAppend(db, "\x1b[K", 3);
+void edMsgBar() {
   int msgLen = strlen(E.smsg);
   if (msgLen > E.sCols) msgLen = E.sCols;
   if (msgLen && time(NULL) - E.smsgTime < 5)
-    dbAppend(db, E.smsg, msgLen);
+    edScreenPuts(E.sRows + 1, 0, E.smsg, msgLen, HL_NORMAL);
 }
 
 void edScroll() {
@@ -146,7 +164,7 @@ void edScroll() {
 
   // compute rX
   if (E.cY < E.nRows) {
-    E.rX = edComputeRx(&E.row[E.cY], E.cX);
+    E.rX = edComputeRx(edRowRead(E.cY), E.cX);
   }
 
   // cursor is above
@@ -10,16 +10,19 @@
 #include "dynamic_str.h"
 #include "editor_configs.h"
 #include "row_operations.h"
+#include "screen.h"
+#include "search_index.h"
 #include "syntax_highlighting.h"
+#include "undo.h"
 
 
 void edClearScreen();
 void edRefreshScreen();
 void edDrawRows();
 void edScroll();
-void edStatusBar(str *db);
+void edStatusBar();
 void edSetSMessage(const char *fmt, ...);
-void edMsgBar(str *db);
+void edMsgBar();
 
 
 #endif // EDITOR_OUTPUT_H_
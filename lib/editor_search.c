@@ -1,69 +1,59 @@
 #include "editor_search.h"
 
-void edSearchCallback(char *q, int k) {
-  static int prevMatch = -1;
-  static int direction = 1; // 1 for forward, -1 for backward
+// is the query a regex, rather than text to look for?
+static int regexMode = 0;
 
-  static int savedHLLine;
-  static char *savedHL = NULL;
+void edSearchCallback(char *q, int k) {
+  static edMatch match; // the match the cursor is on
+  static int found = 0;
 
-  // undo the highlighting for a search query
+  // the matches are drawn over the text until the search is left
   // guaranteed to be called since we use this function when leaving search mode
-  if (savedHL) {
-    memcpy(E.row[savedHLLine].hl, savedHL, E.row[savedHLLine].rSize);
-    free(savedHL);
-    savedHL = NULL;
-  }
+  E.search = NULL;
 
   // set up variables for moving through search results
+  int direction = 1; // 1 for forward, -1 for backward
   if (k == '\r' || k == '\x1b') {
-    prevMatch = -1;
-    direction = 1;
+    found = 0;
     return;
   } else if (k == ARROW_RIGHT || k == ARROW_DOWN) {
     direction = 1;
   } else if (k == ARROW_LEFT || k == ARROW_UP) {
     direction = -1;
   } else {
-    prevMatch = -1;
-    direction = 1;
+    found = 0;
   }
 
-  if (prevMatch == -1) direction = 1; // we search forward by default
-  int current = prevMatch;
-  int i;
-
-  // searches based on current, and current persists due to staticness.
-  // leads to ness-incremental.
-  for (i = 0; i < E.nRows; i++) {
-    current += direction;
-    if (current == -1) current = E.nRows - 1;
-    else if (current == E.nRows) current = 0;
+  // every match is found once per query (or narrowed down from the one typed
+  // before it), and stepping through them is a lookup. a pattern that's
+  // refused (mid-typing, say) matches nothing, and the prompt says why
+  const char *err = NULL;
+  edMatchList *ml = regexMode ? edFindRegex(q, &err) : edFindMatches(q);
+  if (ml == NULL) {
+    if (err) edSetSMessage("Search regex [%s]: %s", err, q);
+    found = 0;
+    return;
+  }
+  E.search = ml;
 
-    edRow *row = &E.row[current];
-    char *match = strstr(row->render, q);
-    if (match) {
-      prevMatch = current;
-      E.cY = current;
-      E.cX = edComputeCx(row, match - row->render);
-      E.rowOff = E.nRows;
+  // a new query starts from the top, like it always did
+  int ok = found ? edNextMatch(ml, match.row, match.col, direction, &match)
+                 : edNextMatch(ml, 0, -1, 1, &match);
+  found = ok;
+  if (!ok) return;
 
-      savedHLLine = current;
-      savedHL = malloc(row->rSize);
-      memcpy(savedHL, row->hl, row->rSize);
-      memset(&row->hl[match - row->render], HL_SEARCH, strlen(q));
-      break;
-    }
-  }
+  E.cY = match.row;
+  E.cX = match.col;
+  E.rowOff = E.nRows;
 }
 
-void edSearch() {
+static void search(char *prompt) {
   int cX_t = E.cX;
   int cY_t = E.cY;
   int colOff_t = E.colOff;
   int rowOff_t = E.rowOff;
 
-  char *q = edPrompt("Search token (ESC/ENTER/Arrows to navigate): %s", edSearchCallback);
+  char *q = edPrompt(prompt, edSearchCallback);
 
   if (q) {
     free(q);
@@ -75,3 +65,13 @@ void edSearch() {
     E.rowOff = rowOff_t;
   }
 }
+
+void edSearch() {
+  regexMode = 0;
+  search("Search token (ESC/ENTER/Arrows to navigate): %s");
+}
+
+void edSearchRegex() {
+  regexMode = 1;
+  search("Search regex (ESC/ENTER/Arrows to navigate): %s");
+}
@@ -9,9 +9,11 @@
 #include "editor_input.h"
 #include "row.h"
 #include "row_operations.h"
+#include "search_index.h"
 
 
 void edSearch();
+void edSearchRegex();
 void edSearchCallback(char *q, int k);
 
 #endif // EDITOR_SEARCH_H_
@@ -1,15 +1,66 @@
 #include "file_io.h"
 
+// the file on disk as the last open or save left it. the rows that are still
+// the line on disk at their own index (see edRow.disk) are the same there,
+// so a save that only added rows past the end can just add those
+static struct {
+  int valid;
+  int mapped; // is it the file E.map maps?
+  int noEOL; // is its last line missing a newline?
+  dev_t dev;
+  ino_t ino;
+  off_t size;
+  struct timespec mtime; // a change that keeps the size still shows here
+} disk;
+
+
+static int edMapFile(char *fname) {
+  // mmap the file and index where its lines start. returns -1 if the file
+  // can't be mapped (e.g. it's empty or not a regular file).
+  int fd = open(fname, O_RDONLY);
+  if (fd == -1) error_exit("open");
+
+  struct stat st;
+  if (fstat(fd, &st) == -1 || !S_ISREG(st.st_mode) || st.st_size == 0) {
+    close(fd);
+    return -1;
+  }
+
+  char *b = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (b == MAP_FAILED) return -1;
+
+  E.map.b = b;
+  E.map.len = st.st_size;
+  E.map.lineOff = edIndexLines(b, E.map.len, &E.map.nLines, &E.map.hasCR);
+
+  disk.valid = 1;
+  disk.mapped = 1;
+  disk.noEOL = b[st.st_size - 1] != '\n';
+  disk.dev = st.st_dev;
+  disk.ino = st.st_ino;
+  disk.size = st.st_size;
+  disk.mtime = st.st_mtim;
+  return 0;
+}
 
 void edOpen(char* fname) {
   free(E.fname);
   E.fname = strdup(fname);
 
+  edChooseHL();
+
+  // rows are only built once they're looked at, see edRowAt
+  if (edMapFile(fname) == 0) {
+    edStoreLoadLazy(E.map.nLines);
+    edUndoClear();
+    E.dirty = 0;
+    return;
+  }
+
   FILE* fp = fopen(fname, "r");
   if (!fp) error_exit("fopen");
 
-  edChooseHL();
-
   char* line = NULL;
   size_t lineCap = 0;
   ssize_t lineLen;
@@ -21,34 +72,380 @@ void edOpen(char* fname) {
 
   free(line);
   fclose(fp);
+  edUndoClear(); // the rows read in aren't changes
   E.dirty = 0; // not actually dirty
 }
 
+void edClose() {
+  // back to an empty buffer. quitting doesn't bother, exit is quicker still.
+  // a save still going needs the rows and the mapped file
+  edSaveWait();
+  edJournalStop();
+  edUndoClear();
+  edStoreFree(&E.rows);
+  disk.valid = 0;
+  E.nRows = 0;
+  E.cX = E.cY = E.rowOff = E.colOff = 0;
+  E.dirty = 0;
+  E.version++;
+
+  // a slice the worker has in hand won't be put back now
+  E.hlValid = E.hlKnown = E.hlBreak = 0;
+  E.hlVersion++;
+
+  if (E.map.b) {
+    munmap(E.map.b, E.map.len);
+    free(E.map.lineOff);
+    E.map.b = NULL;
+  }
+}
+
+
+typedef struct saveBatch {
+  int fd;
+  struct iovec iov[SAVE_IOV];
+  int n;
+  size_t total; // bytes written so far
+  size_t size; // about how many there are to write, for the progress shown
+  time_t shown; // when progress was last shown
+} saveBatch;
+
+// a save runs on a thread of its own, off a snapshot of the rows. only one
+// at a time; a finished one is joined by the next, or by edSaveWait
+enum { SAVE_IDLE, SAVE_RUNNING, SAVE_FINISHED };
+static int saveState = SAVE_IDLE;
+static pthread_t saveThread;
+
+static struct {
+  char *fname;
+  edRowSnap snap;
+  unsigned int version; // E.version when the snapshot was taken
+  int delta; // only added rows to the end of the file
+  size_t kept; // bytes of the file before that
+  struct stat st; // the file as it was left
+} saveJob;
+
+static void saveProgress(saveBatch *sb) {
+  // shows how far along the save is, once a second
+  time_t now = time(NULL);
+  if (now == sb->shown || sb->size == 0) return;
+  sb->shown = now;
+
+  int pct = sb->total < sb->size ? sb->total * 100 / sb->size : 100;
+  pthread_mutex_lock(&E.lock);
+  edSetSMessage("Saving... %d%%", pct);
+  pthread_mutex_unlock(&E.lock);
+  edWakeMain();
+}
+
+static int saveFlush(saveBatch *sb) {
+  // writes out the batch, however many writev it takes. -1 on error
+  struct iovec *v = sb->iov;
+  int n = sb->n;
+  while (n > 0) {
+    ssize_t w = writev(sb->fd, v, n);
+    if (w == -1) {
+      if (errno == EINTR) continue;
+      return -1;
+    }
+    sb->total += w;
+    saveProgress(sb);
+
+    // skip what went out, which may end partway through a piece
+    while (n > 0 && (size_t)w >= v->iov_len) {
+      w -= v->iov_len;
+      v++;
+      n--;
+    }
+    if (n > 0) {
+      v->iov_base = (char *)v->iov_base + w;
+      v->iov_len -= w;
+    }
+  }
+  sb->n = 0;
+  return 0;
+}
+
+static int saveAdd(saveBatch *sb, const char *s, size_t len) {
+  // queues len bytes at s to be written as they are, without copying them
+  if (len == 0) return 0;
+  if (sb->n == SAVE_IOV && saveFlush(sb) == -1) return -1;
+  sb->iov[sb->n].iov_base = (void *)s;
+  sb->iov[sb->n].iov_len = len;
+  sb->n++;
+  return 0;
+}
+
+static size_t saveSize(edRowSnap *snap, int from) {
+  // about how many bytes rows from on come to
+  size_t size = 0;
+  int start = 0;
+  int b;
+  for (b = 0; b < snap->nBlocks; b++) {
+    edRowBlock *blk = snap->blocks[b];
+    int i = from > start ? from - start : 0;
+    if (!blk->rows && i == 0) {
+      size += E.map.lineOff[blk->line + blk->n] - E.map.lineOff[blk->line];
+    } else if (blk->rows) {
+      for (; i < blk->n; i++) size += blk->rows[i].size + 1;
+    }
+    start += blk->n;
+  }
+  return size;
+}
+
+static size_t diskLen(edRowBlock *blk) {
+  // the bytes a lazy block's lines take in the file. once it's been saved
+  // over, they're there without the '\r's the mapped file had
+  size_t len = E.map.lineOff[blk->line + blk->n] - E.map.lineOff[blk->line];
+  if (!E.map.hasCR) return len;
+
+  len = 0;
+  int i;
+  for (i = 0; i < blk->n; i++) {
+    int n;
+    edBlockChars(blk, i, &n);
+    len += n + 1;
+  }
+  return len;
+}
+
+static int saveFrom(edRowSnap *snap, size_t *at, int *lazy) {
+  // the first row that isn't the line on disk at its index, and the offset
+  // in the file where it goes. lazy is set if any row from there on is still
+  // read from the mapped file
+  size_t off = 0;
+  int start = 0;
+  int from = -1;
+  *lazy = 0;
+  int b;
+  for (b = 0; b < snap->nBlocks; b++) {
+    edRowBlock *blk = snap->blocks[b];
+    if (from < 0 && !blk->rows && blk->disk == start) {
+      off += diskLen(blk);
+    } else if (from < 0 && blk->rows) {
+      int i;
+      for (i = 0; i < blk->n && blk->rows[i].disk == start + i; i++)
+        off += blk->rows[i].size + 1;
+      if (i < blk->n) from = start + i;
+    } else {
+      if (from < 0) from = start;
+      if (!blk->rows) *lazy = 1;
+    }
+    start += blk->n;
+  }
+  *at = off;
+  return from < 0 ? start : from;
+}
+
+static int saveRows(saveBatch *sb, edRowSnap *snap, int from) {
+  // every row from on and its newline, straight out of the snapshot
+  int start = 0;
+  int b;
+  for (b = 0; b < snap->nBlocks; b++) {
+    edRowBlock *blk = snap->blocks[b];
+    int off = from > start ? from - start : 0;
+    start += blk->n;
+    if (off >= blk->n) continue;
+
+    if (!blk->rows && !E.map.hasCR && off == 0) {
+      // a lazy block is a run of lines of the mapped file, newlines and all.
+      // the last line of the file may be missing its newline
+      size_t from = E.map.lineOff[blk->line];
+      size_t to = E.map.lineOff[blk->line + blk->n];
+      if (to > E.map.len) {
+        if (saveAdd(sb, &E.map.b[from], E.map.len - from) == -1) return -1;
+        if (saveAdd(sb, "\n", 1) == -1) return -1;
+      } else if (saveAdd(sb, &E.map.b[from], to - from) == -1) {
+        return -1;
+      }
+      continue;
+    }
+
+    for (; off < blk->n; off++) {
+      int len;
+      char *s = edBlockChars(blk, off, &len);
+      if (saveAdd(sb, s, len) == -1) return -1;
+      if (saveAdd(sb, "\n", 1) == -1) return -1;
+    }
+  }
+  return saveFlush(sb);
+}
+
+static void syncDir(const char *path) {
+  // makes the rename of a file in it stick
+  const char *slash = strrchr(path, '/');
+  char *dir = slash ? strndup(path, slash - path + 1) : strdup(".");
+  int fd = open(dir, O_RDONLY);
+  if (fd != -1) {
+    fsync(fd);
+    close(fd);
+  }
+  free(dir);
+}
+
+static int saveWhole(const char *path, edRowSnap *snap, saveBatch *sb) {
+  // writes the document to a file next to path, and then renames it over
+  // path. a crash partway through leaves the old file as it was. it's also
+  // what keeps the mapped file behind lazy rows intact
+  char *tmp = malloc(strlen(path) + 8);
+  sprintf(tmp, "%s.XXXXXX", path);
+  int fd = mkstemp(tmp);
+  if (fd == -1) {
+    free(tmp);
+    return -1;
+  }
+
+  // the new file takes over the old one's permissions (and owner, if we may)
+  struct stat st;
+  if (stat(path, &st) == 0) {
+    fchmod(fd, st.st_mode & 07777);
+    fchown(fd, st.st_uid, st.st_gid);
+  } else {
+    mode_t mask = umask(0);
+    umask(mask);
+    fchmod(fd, 0644 & ~mask);
+  }
+
+  sb->fd = fd;
+  int r = saveRows(sb, snap, 0);
+  if (r == 0) r = fsync(fd);
+  if (r == 0) r = fstat(fd, &saveJob.st);
+  if (close(fd) == -1) r = -1;
+  if (r == 0) r = rename(tmp, path);
+
+  if (r == -1) {
+    int e = errno;
+    unlink(tmp);
+    errno = e;
+  } else {
+    syncDir(path);
+  }
+  free(tmp);
+  return r;
+}
+
+static int saveAppend(const char *path, edRowSnap *snap, int from, size_t at, saveBatch *sb) {
+  // adds rows from on to the end of the file in place. nothing in it is
+  // written over, and the journal says it's growing first (edJournalGrow), so
+  // a crash partway through leaves a file that's cut back to what it was and
+  // replayed
+  int fd = open(path, O_WRONLY);
+  if (fd == -1) return -1;
 
+  // the last line on disk gets the newline it was missing
+  if (at > (size_t)disk.size) {
+    at--;
+    saveAdd(sb, "\n", 1);
+  }
 
+  sb->fd = fd;
+  int r = lseek(fd, at, SEEK_SET) == -1 ? -1 : saveRows(sb, snap, from);
+  if (r == 0) r = fsync(fd);
+  if (r == 0) r = fstat(fd, &saveJob.st);
+  if (close(fd) == -1) r = -1;
+  saveJob.kept = at;
+  return r;
+}
 
-void *edRowsToString(int *bufLen) {
-  // get the length of all the rows
-  int totalLen = 0;
-  int j;
-  for (j = 0; j < E.nRows; j++) {
-    totalLen += E.row[j].size + 1;
+static int saveFile(const char *fname, edRowSnap *snap, size_t *len) {
+  char *path = realpath(fname, NULL); // a symlink stays one
+  if (path == NULL) {
+    if (errno != ENOENT) return -1;
+    path = strdup(fname);
   }
-  *bufLen = totalLen;
 
-  char *buf = malloc(totalLen);
-  char *p = buf;
-  for (j = 0; j < E.nRows; j++) {
-    memcpy(p, E.row[j].chars, E.row[j].size);
-    p += E.row[j].size;
-    *p = '\n';
-    p++;
+  // if the file is still as the last open or save left it, and the only
+  // change is rows added past its end, those are added to it in place. that's
+  // not to be done to the mapped file if lazy rows from there on still read
+  // from it, or to a mapped file with '\r's, as rows go back with '\n's alone.
+  // anything else is saved whole, so a crash can't leave the file half old
+  // and half new
+  int from = 0;
+  size_t at = 0;
+  struct stat st;
+  saveJob.delta = 0;
+  if (disk.valid && !(disk.mapped && E.map.hasCR) && stat(path, &st) == 0 &&
+      st.st_dev == disk.dev && st.st_ino == disk.ino && st.st_size == disk.size &&
+      st.st_mtim.tv_sec == disk.mtime.tv_sec && st.st_mtim.tv_nsec == disk.mtime.tv_nsec) {
+    int lazy;
+    from = saveFrom(snap, &at, &lazy);
+    saveJob.delta = !(disk.mapped && lazy) && at >= (size_t)disk.size &&
+                    at <= (size_t)disk.size + disk.noEOL && edJournalGrow(disk.size) == 0;
   }
-  return buf;
+  if (!saveJob.delta) from = 0;
+
+  saveBatch sb;
+  sb.n = 0;
+  sb.total = 0;
+  sb.size = saveSize(snap, from);
+  sb.shown = time(NULL);
+  int r = saveJob.delta ? saveAppend(path, snap, from, at, &sb) : saveWhole(path, snap, &sb);
+
+  *len = sb.total;
+  free(path);
+  return r;
 }
 
 
+static void *saveWorker(void *unused) {
+  // writes the snapshot out without the lock, and only takes it to say so
+  (void)unused;
+  size_t len;
+  int r = saveFile(saveJob.fname, &saveJob.snap, &len);
+  int err = errno;
+
+  pthread_mutex_lock(&E.lock);
+  edStoreSnapFree(&saveJob.snap);
+  free(saveJob.fname);
+  edJournalSaved(r == 0);
+
+  if (r == 0) {
+    // changes made while it was saving are still unsaved, and leave the rows'
+    // disk lines out of step with the file until the next whole save
+    int changed = E.version != saveJob.version;
+    if (!changed) {
+      E.dirty = 0;
+      edStoreMarkSaved();
+    }
+    disk.valid = !changed;
+    disk.mapped = disk.mapped && saveJob.delta;
+    disk.noEOL = 0;
+    disk.dev = saveJob.st.st_dev;
+    disk.ino = saveJob.st.st_ino;
+    disk.size = saveJob.st.st_size;
+    disk.mtime = saveJob.st.st_mtim;
+
+    if (saveJob.delta) {
+      edSetSMessage("%zu bytes written, the first %zu kept%s", len, saveJob.kept,
+                    changed ? ", changed since" : "");
+    } else {
+      edSetSMessage("%zu bytes written%s", len, changed ? ", changed since" : "");
+    }
+  } else {
+    // a file added to in place may be partway there
+    if (saveJob.delta) disk.valid = 0;
+    edSetSMessage("save error: %s", strerror(err));
+  }
+  pthread_mutex_unlock(&E.lock);
+  edWakeMain();
+
+  // the journal starts over, mostly without the lock. the save isn't done
+  // until it has, so a new one doesn't start before
+  edJournalRewrite();
+  pthread_mutex_lock(&E.lock);
+  saveState = SAVE_FINISHED;
+  pthread_mutex_unlock(&E.lock);
+  return NULL;
+}
+
 void edSave() {
+  if (saveState == SAVE_RUNNING) {
+    edSetSMessage("Still saving...");
+    return;
+  }
+  edSaveWait();
+
   if (E.fname == NULL) {
     E.fname = edPrompt("Save as (ESC to cancel): %s", NULL);
     if (E.fname == NULL) {
@@ -58,22 +455,28 @@ void edSave() {
     edChooseHL();
   }
 
-  int len;
-  char *buf = edRowsToString(&len);
+  // the snapshot is all that's done here; editing goes on while it's written
+  saveJob.fname = strdup(E.fname);
+  saveJob.version = E.version;
+  edStoreSnap(&saveJob.snap);
+  edJournalMark();
 
-  int fd = open(E.fname, O_RDWR | O_CREAT, 0644);
-  if (fd != 1) {
-    if (ftruncate(fd, len) != 1) {
-      if (write(fd, buf, len) == len) {
-        close(fd);
-        free(buf);
-        edSetSMessage("%d bytes written", len);
-        E.dirty = 0; // no longer dirty
-        return;
-      }
-    }
-    close(fd);
+  int r = pthread_create(&saveThread, NULL, saveWorker, NULL);
+  if (r != 0) {
+    edStoreSnapFree(&saveJob.snap);
+    free(saveJob.fname);
+    edSetSMessage("save error: %s", strerror(r));
+    return;
   }
-  free(buf);
-  edSetSMessage("save error: %s", strerror(errno));
+  saveState = SAVE_RUNNING;
+  edSetSMessage("Saving...");
+}
+
+void edSaveWait() {
+  // waits for a save in progress to be done
+  if (saveState == SAVE_IDLE) return;
+  pthread_mutex_unlock(&E.lock);
+  pthread_join(saveThread, NULL);
+  pthread_mutex_lock(&E.lock);
+  saveState = SAVE_IDLE;
 }
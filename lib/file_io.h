@@ -1,7 +1,9 @@
 #ifndef FILE_IO_H_
 #define FILE_IO_H_
 
+#ifndef _DEFAULT_SOURCE
 #define _DEFAULT_SOURCE
+#endif
 #define _BSD_SOURCE
 #define _GNU_SOURCE
 
@@ -11,16 +13,27 @@
 #include <string.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <sys/types.h>
+#include <sys/uio.h>
+#include <unistd.h>
 
 #include "editor_configs.h"
 #include "editor_input.h"
+#include "journal.h"
+#include "line_index.h"
 #include "row.h"
 #include "terminal_config.h"
+#include "undo.h"
+
+// rows are saved this many pieces (a row, or a run of lazy rows) per writev
+#define SAVE_IOV 1024
 
 
 void edOpen(char *fname);
-void *edRowsToString(int *bufLen);
+void edClose();
 void edSave();
+void edSaveWait();
 
 #endif // FILE_IO_H_
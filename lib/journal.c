@@ -0,0 +1,456 @@
+#include "journal.h"
+#include "editor_output.h"
+#include "file_io.h"
+#include "row_operations.h"
+
+// the journal starts with this, saying which version of the file its records
+// go on top of. grow is set while a save adds to the end of that file in
+// place: a crash then leaves it longer, and it's cut back to size
+typedef struct jrHeader {
+  char magic[8];
+  long long dev, ino, size, mtime, mtimeNs;
+  long long grow;
+} jrHeader;
+
+#define JOURNAL_MAGIC "edjrnl2"
+
+// the journal of the file being edited. guarded by E.lock, like the rows
+static struct {
+  int fd; // -1 while there's none
+  char *path;
+  str buf; // records not written yet
+  off_t len; // bytes in the file
+  int keep; // a save is under way: the records it misses are kept in since
+  str since;
+} jr = {-1, NULL, ABUF_INIT, 0, 0, ABUF_INIT};
+
+// the journal a finished save starts over with. edJournalSaved sets it up
+// under the lock, and edJournalRewrite writes it out in the save thread
+static struct {
+  int pending;
+  char *fname;
+  str tail; // the records the save missed
+  int fd; // the save's own dup of the journal, for edJournalGrow
+} rw = {0, NULL, ABUF_INIT, -1};
+
+// a thread of its own fsyncs the journal, so the main thread never waits on
+// one. it syncs a dup of syncFd, so the journal can be swapped or closed
+// while it does
+static pthread_mutex_t syncLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t syncWake = PTHREAD_COND_INITIALIZER;
+static int syncFd = -1;
+static int syncDue; // written to since the last fsync
+static int syncs;
+
+static void *syncWorker(void *unused) {
+  (void)unused;
+  pthread_mutex_lock(&syncLock);
+  while (1) {
+    while (!syncDue) pthread_cond_wait(&syncWake, &syncLock);
+
+    // the rest of the burst is let in first
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    ts.tv_sec += JOURNAL_SYNC_MS / 1000;
+    ts.tv_nsec += (JOURNAL_SYNC_MS % 1000) * 1000000L;
+    if (ts.tv_nsec >= 1000000000L) {
+      ts.tv_sec++;
+      ts.tv_nsec -= 1000000000L;
+    }
+    while (pthread_cond_timedwait(&syncWake, &syncLock, &ts) != ETIMEDOUT);
+
+    syncDue = 0;
+    int fd = syncFd == -1 ? -1 : dup(syncFd);
+    pthread_mutex_unlock(&syncLock);
+    if (fd != -1) {
+      fdatasync(fd);
+      close(fd);
+    }
+    pthread_mutex_lock(&syncLock);
+    syncs++;
+  }
+  return NULL;
+}
+
+static void syncSet(int fd) {
+  // hands the sync thread the journal, starting it the first time
+  static int started = 0;
+  if (!started) {
+    pthread_t t;
+    if (pthread_create(&t, NULL, syncWorker, NULL) == 0) pthread_detach(t);
+    started = 1;
+  }
+  pthread_mutex_lock(&syncLock);
+  syncFd = fd;
+  pthread_mutex_unlock(&syncLock);
+}
+
+static void syncSoon() {
+  pthread_mutex_lock(&syncLock);
+  if (!syncDue) {
+    syncDue = 1;
+    pthread_cond_signal(&syncWake);
+  }
+  pthread_mutex_unlock(&syncLock);
+}
+
+
+static char *journalPath(const char *fname) {
+  // .name.journal, next to the file
+  const char *base = strrchr(fname, '/');
+  base = base ? base + 1 : fname;
+  char *path = malloc(strlen(fname) + 10);
+  sprintf(path, "%.*s.%s.journal", (int)(base - fname), fname, base);
+  return path;
+}
+
+static int fileHeader(const char *fname, jrHeader *h) {
+  // the header of a journal for the file as it is now
+  struct stat st;
+  if (stat(fname, &st) == -1) return -1;
+  memset(h, 0, sizeof(*h));
+  memcpy(h->magic, JOURNAL_MAGIC, sizeof(h->magic));
+  h->dev = st.st_dev;
+  h->ino = st.st_ino;
+  h->size = st.st_size;
+  h->mtime = st.st_mtim.tv_sec;
+  h->mtimeNs = st.st_mtim.tv_nsec;
+  return 0;
+}
+
+static int headerGrown(const jrHeader *old, const jrHeader *h) {
+  // is the file the one old was for, with only more added to its end?
+  return memcmp(old->magic, h->magic, sizeof(h->magic)) == 0 && old->dev == h->dev &&
+         old->ino == h->ino && old->size <= h->size;
+}
+
+static int writeAll(int fd, const char *s, size_t len) {
+  while (len > 0) {
+    ssize_t w = write(fd, s, len);
+    if (w == -1) {
+      if (errno == EINTR) continue;
+      return -1;
+    }
+    s += w;
+    len -= w;
+  }
+  return 0;
+}
+
+static char *readAll(const char *path, size_t *len) {
+  // the whole of the file at path, NULL if there isn't one
+  int fd = open(path, O_RDONLY);
+  if (fd == -1) return NULL;
+  struct stat st;
+  char *b = NULL;
+  if (fstat(fd, &st) == 0 && (b = malloc(st.st_size + 1))) {
+    *len = 0;
+    ssize_t r;
+    while (*len < (size_t)st.st_size && (r = read(fd, &b[*len], st.st_size - *len)) > 0)
+      *len += r;
+  }
+  close(fd);
+  return b;
+}
+
+static void journalSet(int fd, char *path, off_t len) {
+  syncSet(fd);
+  if (jr.fd != -1) close(jr.fd);
+  if (jr.path && path && strcmp(jr.path, path) != 0) unlink(jr.path);
+  free(jr.path);
+  jr.fd = fd;
+  jr.path = path;
+  jr.len = len;
+  jr.keep = 0;
+  dbReset(&jr.buf);
+  dbReset(&jr.since);
+}
+
+
+static void putNum(size_t n) {
+  // 7 bits at a time, low ones first, with the high bit set on all but the last
+  while (n >= 0x80) {
+    dbAppendChar(&jr.buf, (n & 0x7f) | 0x80);
+    n >>= 7;
+  }
+  dbAppendChar(&jr.buf, n);
+}
+
+static int getNum(const char *b, size_t len, size_t *p, size_t *n) {
+  int shift = 0;
+  *n = 0;
+  while (*p < len && shift < 64) {
+    unsigned char c = b[(*p)++];
+    *n |= (size_t)(c & 0x7f) << shift;
+    if (!(c & 0x80)) return 1;
+    shift += 7;
+  }
+  return 0;
+}
+
+#define OP_HAS_COL(op) ((op) == JOURNAL_INSERT || (op) == JOURNAL_REMOVE || (op) == JOURNAL_TRUNCATE)
+#define OP_HAS_TEXT(op) ((op) == JOURNAL_INSERT || (op) == JOURNAL_ROW || (op) == JOURNAL_LINES)
+#define OP_HAS_LEN(op) (OP_HAS_TEXT(op) || (op) == JOURNAL_REMOVE)
+
+void edJournal(int op, int row, int col, const char *s, size_t len) {
+  // queues the record of a change just made, for edJournalFlush to write
+  if (jr.fd == -1 && !jr.keep) return;
+  dbAppendChar(&jr.buf, op);
+  putNum(row);
+  if (OP_HAS_COL(op)) putNum(col);
+  if (OP_HAS_LEN(op)) putNum(len);
+  if (OP_HAS_TEXT(op)) dbAppend(&jr.buf, s, len);
+}
+
+static int replayOne(int op, size_t row, size_t col, const char *s, size_t len) {
+  // row and col have to make sense for op, or it's not a record at all
+  if (row > (size_t)E.nRows) return 0;
+  switch (op) {
+    case JOURNAL_ROW:
+      edInsertRow(row, (char *)s, len);
+      return 1;
+    case JOURNAL_LINES:
+      edInsertLines(row, (char *)s, len);
+      return 1;
+  }
+
+  if (row == (size_t)E.nRows) return 0;
+  edRow *r = edRowAt(row);
+  switch (op) {
+    case JOURNAL_INSERT:
+      if (col > (size_t)r->size) return 0;
+      edRowInsertStr(r, col, (char *)s, len);
+      return 1;
+    case JOURNAL_REMOVE:
+      if (col >= (size_t)r->size || len > r->size - col) return 0;
+      edRowDeleteStr(r, col, len);
+      return 1;
+    case JOURNAL_TRUNCATE:
+      if (col >= (size_t)r->size) return 0;
+      edRowTruncate(r, col);
+      return 1;
+    case JOURNAL_DELETE:
+      edDeleteRow(row);
+      return 1;
+  }
+  return 0;
+}
+
+static size_t replay(const char *b, size_t len, int *n) {
+  // makes each change in turn, up to the end or the first record that's cut
+  // short or doesn't fit (the tail of a write a crash cut off). returns the
+  // bytes of records that were good
+  size_t p = 0;
+  *n = 0;
+  while (p < len) {
+    int op = (unsigned char)b[p];
+    size_t q = p + 1;
+    size_t row = 0, col = 0, tLen = 0;
+    if (op != JOURNAL_SAVE) {
+      if (!getNum(b, len, &q, &row)) break;
+      if (OP_HAS_COL(op) && !getNum(b, len, &q, &col)) break;
+      if (OP_HAS_LEN(op) && !getNum(b, len, &q, &tLen)) break;
+      if (OP_HAS_TEXT(op) && tLen > len - q) break;
+      if (!replayOne(op, row, col, &b[q], tLen)) break;
+      (*n)++;
+    }
+    p = q + (OP_HAS_TEXT(op) ? tLen : 0);
+  }
+  return p;
+}
+
+void edJournalStart() {
+  // replays the journal an editor that didn't get to quit left behind, if
+  // it's for the file as it is now, and then goes on keeping it
+  jrHeader h;
+  if (jr.fd != -1 || E.fname == NULL || fileHeader(E.fname, &h) == -1) return;
+  char *path = journalPath(E.fname);
+
+  size_t len;
+  char *b = readAll(path, &len);
+  off_t keep = 0;
+  jrHeader *old = b && len >= sizeof(h) ? (jrHeader *)b : NULL;
+  if (old && old->grow && headerGrown(old, &h)) {
+    // a save was adding to the file when the editor went. what it added is
+    // cut off, and the file opened again as it was
+    char *fname = strdup(E.fname);
+    if (truncate(fname, old->size) == 0) {
+      edClose();
+      edOpen(fname);
+      fileHeader(fname, &h);
+      old->size = h.size;
+      old->mtime = h.mtime;
+      old->mtimeNs = h.mtimeNs;
+      old->grow = 0;
+    }
+    free(fname);
+  }
+  if (old && memcmp(old, &h, sizeof(h)) == 0) {
+    int n;
+    keep = sizeof(h) + replay(&b[sizeof(h)], len - sizeof(h), &n);
+    if (n) edSetSMessage("recovered %d edits from %s", n, path);
+  } else if (b) {
+    // one for some other version of the file is put out of the way
+    char *old = malloc(strlen(path) + 2);
+    sprintf(old, "%s~", path);
+    rename(path, old);
+    edSetSMessage("%s doesn't go with the file, moved to %s", path, old);
+    free(old);
+  }
+  free(b);
+
+  int fd = open(path, O_RDWR | O_CREAT | (keep ? 0 : O_TRUNC), 0600);
+  if (fd == -1 || (keep ? ftruncate(fd, keep) == -1 || lseek(fd, keep, SEEK_SET) == -1
+                        : writeAll(fd, (char *)&h, sizeof(h)) == -1)) {
+    edSetSMessage("no journal: %s", strerror(errno));
+    if (fd != -1) close(fd);
+    free(path);
+    return;
+  }
+  journalSet(fd, path, keep ? keep : (off_t)sizeof(h));
+  syncSoon();
+}
+
+void edJournalStop() {
+  // done with the file, saved or not, so its journal goes
+  jr.keep = 0;
+  dbReset(&jr.since);
+  if (jr.fd == -1) return;
+  syncSet(-1);
+  close(jr.fd);
+  unlink(jr.path);
+  free(jr.path);
+  jr.fd = -1;
+  jr.path = NULL;
+  dbReset(&jr.buf);
+}
+
+int edJournalOn() {
+  // records are taken while a save is under way even with no journal yet
+  return jr.fd != -1 || jr.keep;
+}
+
+void edJournalFlush() {
+  // hands the records so far to the kernel, which is as far as they have to
+  // get to outlive the editor. the sync thread takes them on to the disk
+  if (jr.buf.len == 0) return;
+  if (jr.keep) dbAppend(&jr.since, jr.buf.b, jr.buf.len);
+  if (jr.fd == -1) {
+    dbReset(&jr.buf);
+    return;
+  }
+  if (writeAll(jr.fd, jr.buf.b, jr.buf.len) == -1) {
+    edSetSMessage("journal error: %s", strerror(errno));
+    dbReset(&jr.buf);
+    return;
+  }
+  jr.len += jr.buf.len;
+  dbReset(&jr.buf);
+  syncSoon();
+}
+
+void edJournalMark() {
+  // a save is taking its snapshot. the records after this are what it misses,
+  // and they're kept for the journal to start over with once it's done
+  if (jr.fd != -1) dbAppendChar(&jr.buf, JOURNAL_SAVE);
+  edJournalFlush();
+  dbReset(&jr.since);
+  jr.keep = 1;
+
+  if (rw.fd != -1) close(rw.fd);
+  rw.fd = jr.fd == -1 ? -1 : dup(jr.fd);
+}
+
+int edJournalGrow(off_t size) {
+  // called by the save thread before it adds to the end of the file in
+  // place, from size on. the header says so, on disk, first. -1 if it can't,
+  // and the file is to be saved whole
+  jrHeader h;
+  if (rw.fd == -1 || pread(rw.fd, &h, sizeof(h), 0) != sizeof(h) || h.size != size) return -1;
+  h.grow = 1;
+  if (pwrite(rw.fd, &h, sizeof(h), 0) != sizeof(h) || fdatasync(rw.fd) == -1) return -1;
+  return 0;
+}
+
+void edJournalSaved(int saved) {
+  // the save is over. if it went through, the file has everything up to the
+  // mark, and the journal is to start over with only the records after it.
+  // this just takes them, edJournalRewrite does the writing
+  edJournalFlush();
+  if (rw.fd != -1) close(rw.fd);
+  rw.fd = -1;
+  if (!saved || E.fname == NULL) {
+    jr.keep = 0;
+    dbReset(&jr.since);
+    return;
+  }
+
+  rw.pending = 1;
+  free(rw.fname);
+  rw.fname = strdup(E.fname);
+  rw.tail = jr.since;
+  jr.since = (str)ABUF_INIT;
+}
+
+void edJournalRewrite() {
+  // called by the save thread, without the lock, after edJournalSaved. the
+  // new journal is written and fsynced next to the old one. then, under the
+  // lock, it gets the records made since and takes over from the old one,
+  // and is renamed over it once the lock is let go. a crash before the
+  // rename finds the old journal, which doesn't go with the saved file,
+  // just as during the save itself
+  if (!rw.pending) return;
+  rw.pending = 0;
+
+  jrHeader h;
+  char *path = journalPath(rw.fname);
+  char *tmp = malloc(strlen(path) + 8);
+  sprintf(tmp, "%s.XXXXXX", path);
+  int fd = fileHeader(rw.fname, &h) == -1 ? -1 : mkstemp(tmp);
+  int r = fd == -1 ? -1 : writeAll(fd, (char *)&h, sizeof(h));
+  if (r == 0) r = writeAll(fd, rw.tail.b, rw.tail.len);
+  if (r == 0) r = fsync(fd);
+  int err = errno;
+
+  pthread_mutex_lock(&E.lock);
+  edJournalFlush();
+  if (r == 0 && (r = writeAll(fd, jr.since.b, jr.since.len)) == -1) err = errno;
+  if (r == 0) {
+    journalSet(fd, path, sizeof(h) + rw.tail.len + jr.since.len);
+    syncSoon();
+  } else {
+    edSetSMessage("journal error: %s", strerror(err));
+    jr.keep = 0;
+    dbReset(&jr.since);
+    if (fd != -1) {
+      close(fd);
+      unlink(tmp);
+    }
+    free(path);
+  }
+  pthread_mutex_unlock(&E.lock);
+  dbFree(&rw.tail);
+
+  if (r == 0 && rename(tmp, path) == -1) {
+    // the journal there is left for the old file, and goes aside next time
+    pthread_mutex_lock(&E.lock);
+    edSetSMessage("journal error: %s", strerror(errno));
+    free(jr.path);
+    jr.path = tmp;
+    tmp = NULL;
+    edJournalStop();
+    pthread_mutex_unlock(&E.lock);
+  }
+  free(tmp);
+}
+
+size_t edJournalSize() {
+  return jr.fd == -1 ? 0 : jr.len + jr.buf.len;
+}
+
+int edJournalSyncs() {
+  pthread_mutex_lock(&syncLock);
+  int n = syncs;
+  pthread_mutex_unlock(&syncLock);
+  return n;
+}
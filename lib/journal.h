@@ -0,0 +1,52 @@
+#ifndef JOURNAL_H_
+#define JOURNAL_H_
+
+#ifndef _DEFAULT_SOURCE
+#define _DEFAULT_SOURCE
+#endif
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "constants.h"
+#include "dynamic_str.h"
+#include "editor_configs.h"
+
+// every change to the rows goes into a journal next to the file, so what
+// wasn't saved can be replayed over the file after a crash. a record is one
+// of these bytes, then its numbers as varints, then the bytes of any text
+enum edJournalOp {
+  JOURNAL_INSERT = 'i', // row, col, len, text: edRowInsertStr
+  JOURNAL_REMOVE = 'x', // row, col, len: edRowDeleteStr
+  JOURNAL_TRUNCATE = 't', // row, col: edRowTruncate
+  JOURNAL_ROW = 'r', // row, len, text: edInsertRow
+  JOURNAL_LINES = 'l', // row, len, text: edInsertLines
+  JOURNAL_DELETE = 'd', // row: edDeleteRow
+  JOURNAL_SAVE = 's' // a save took its snapshot here
+};
+
+// records are written as they're made, and fsynced this long after the first
+// one since the last fsync, so a burst of keys costs one
+#define JOURNAL_SYNC_MS 1000
+
+
+void edJournalStart();
+void edJournalStop();
+int edJournalOn();
+void edJournal(int op, int row, int col, const char *s, size_t len);
+void edJournalFlush();
+void edJournalMark();
+int edJournalGrow(off_t size);
+void edJournalSaved(int saved);
+void edJournalRewrite();
+size_t edJournalSize();
+int edJournalSyncs();
+
+#endif // JOURNAL_H_
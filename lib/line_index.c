@@ -0,0 +1,116 @@
+#include "line_index.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// line starts found in one chunk of the buffer
+typedef struct idxChunk {
+  size_t *off;
+  size_t n;
+  size_t cap;
+  int hasCR;
+} idxChunk;
+
+typedef struct idxJob {
+  const char *b;
+  size_t len;
+  idxChunk *chunks;
+  size_t *base; // where each chunk's entries go in the table
+  size_t *table;
+} idxJob;
+
+static void idxPush(idxChunk *c, size_t off) {
+  if (c->n == c->cap) {
+    c->cap = c->cap ? c->cap * 2 : 4096;
+    c->off = realloc(c->off, sizeof(size_t) * c->cap);
+  }
+  c->off[c->n++] = off;
+}
+
+static void idxScan(void *arg, int i) {
+  idxJob *job = arg;
+  idxChunk *c = &job->chunks[i];
+  const char *b = job->b;
+
+  size_t p = (size_t)i * INDEX_CHUNK;
+  size_t end = p + INDEX_CHUNK;
+  if (end > job->len) end = job->len;
+
+#if defined(__SSE2__)
+  // 64 bytes per step: compare against '\n' into one bit mask, and just
+  // remember whether any '\r' went by
+  const __m128i nl = _mm_set1_epi8('\n');
+  const __m128i cr = _mm_set1_epi8('\r');
+  __m128i anyCR = _mm_setzero_si128();
+
+  for (; p + 64 <= end; p += 64) {
+    __m128i x0 = _mm_loadu_si128((const __m128i *)&b[p]);
+    __m128i x1 = _mm_loadu_si128((const __m128i *)&b[p + 16]);
+    __m128i x2 = _mm_loadu_si128((const __m128i *)&b[p + 32]);
+    __m128i x3 = _mm_loadu_si128((const __m128i *)&b[p + 48]);
+
+    unsigned long long m =
+      (unsigned long long)(unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(x0, nl)) |
+      (unsigned long long)(unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(x1, nl)) << 16 |
+      (unsigned long long)(unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(x2, nl)) << 32 |
+      (unsigned long long)(unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(x3, nl)) << 48;
+
+    anyCR = _mm_or_si128(anyCR,
+              _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(x0, cr), _mm_cmpeq_epi8(x1, cr)),
+                           _mm_or_si128(_mm_cmpeq_epi8(x2, cr), _mm_cmpeq_epi8(x3, cr))));
+
+    while (m) {
+      idxPush(c, p + __builtin_ctzll(m) + 1);
+      m &= m - 1;
+    }
+  }
+  if (_mm_movemask_epi8(anyCR)) c->hasCR = 1;
+#endif
+
+  // whatever's left (or everything, without SSE2)
+  for (; p < end; p++) {
+    if (b[p] == '\n') idxPush(c, p + 1);
+    else if (b[p] == '\r') c->hasCR = 1;
+  }
+}
+
+static void idxCopy(void *arg, int i) {
+  idxJob *job = arg;
+  idxChunk *c = &job->chunks[i];
+  memcpy(&job->table[job->base[i]], c->off, sizeof(size_t) * c->n);
+  free(c->off);
+}
+
+size_t *edIndexLines(const char *b, size_t len, int *nLines, int *hasCR) {
+  int nChunks = (len + INDEX_CHUNK - 1) / INDEX_CHUNK;
+  idxJob job;
+  job.b = b;
+  job.len = len;
+  job.chunks = calloc(nChunks ? nChunks : 1, sizeof(idxChunk));
+  job.base = malloc(sizeof(size_t) * (nChunks ? nChunks : 1));
+
+  edPoolRun(idxScan, &job, nChunks);
+
+  // line 0 starts at 0, every other line right after a newline
+  size_t total = 1;
+  int i;
+  *hasCR = 0;
+  for (i = 0; i < nChunks; i++) {
+    job.base[i] = total;
+    total += job.chunks[i].n;
+    if (job.chunks[i].hasCR) *hasCR = 1;
+  }
+
+  job.table = malloc(sizeof(size_t) * (total + 1));
+  job.table[0] = 0;
+  edPoolRun(idxCopy, &job, nChunks);
+
+  // a trailing newline already gives the end of the last line
+  if (job.table[total - 1] != len) job.table[total++] = len + 1;
+  *nLines = total - 1;
+
+  free(job.chunks);
+  free(job.base);
+  return job.table;
+}
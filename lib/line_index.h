@@ -0,0 +1,17 @@
+#ifndef LINE_INDEX_H_
+#define LINE_INDEX_H_
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "thread_pool.h"
+
+// bytes scanned by one task of the parallel line indexer
+#define INDEX_CHUNK (8 << 20)
+
+// finds the start of every line in b, splitting the work across the thread
+// pool. the result has nLines + 1 entries, laid out like edFileMap.lineOff.
+// hasCR is set if the buffer has any '\r' that line endings may need trimming of.
+size_t *edIndexLines(const char *b, size_t len, int *nLines, int *hasCR);
+
+#endif // LINE_INDEX_H_
@@ -0,0 +1,868 @@
+#include "regex_dfa.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// the alphabet is every byte, plus a symbol each for the start and end of the
+// line, which is what ^ and $ match
+#define SYM_BOL 256
+#define SYM_EOL 257
+#define SYMS 258
+
+enum reNodeType { RE_EMPTY, RE_SET, RE_BOL, RE_EOL, RE_CAT, RE_ALT, RE_STAR,
+                  RE_PLUS, RE_QUEST, RE_REP };
+
+typedef struct reNode {
+  int type;
+  int a, b; // children, or a is the set of RE_SET
+  int min, max; // RE_REP, max -1 for no limit
+} reNode;
+
+// instructions of the pike-style program. SET, ANY, BOL and EOL consume a
+// symbol and carry on at the next one
+enum reOp { OP_SET, OP_ANY, OP_BOL, OP_EOL, OP_SPLIT, OP_JMP, OP_MATCH };
+
+typedef struct reInst {
+  int op;
+  int x, y; // jump targets, or x is the set of OP_SET
+} reInst;
+
+typedef struct reProg {
+  reInst *inst;
+  int n, cap;
+} reProg;
+
+typedef unsigned int reSet[8];
+
+struct edRegex {
+  reSet *sets;
+  int nSets;
+  reProg fwd; // the pattern
+  reProg rev; // the pattern backwards, to find how far matches go
+};
+
+// the programs have a loop over any symbol first, so starting at ANCHORED
+// matches only from where it starts, and at 0 from anywhere after
+#define UNANCHORED 0
+#define ANCHORED 3
+
+// the dfa for one program. a state is a set of instructions, and its row of
+// trans is filled in a symbol at a time as text needs it. state 0 is the
+// empty set, which never matches again
+typedef struct reCache {
+  reProg *prog;
+  int *trans; // SYMS per state: -1 while not worked out, -2 - t for a state t that matches
+  unsigned char *match;
+  int *setOff, *setLen; // each state's instructions, in pcs
+  int *pcs;
+  int nPcs, capPcs;
+  int nStates, cap;
+  int *hash; // state indexes, open addressing, -1 empty
+  int hashMask;
+  int start; // the state a search starts in, -1 unknown
+  // the unanchored start state, if only a few bytes lead out of it. until
+  // one of them comes up, there's nothing to do. -1 not worked out, -2 none
+  int accelState;
+  int nAccel;
+  unsigned char accel[3];
+  unsigned int resets; // bumped whenever the states are thrown away
+} reCache;
+
+struct edDFA {
+  edRegex *re;
+  reCache fwd;
+  int *mark; // instructions already in the set being built
+  int gen;
+  int *list, *stack;
+  // the threads of the pass backwards (see dfaEnds), and the end of the
+  // match each is for
+  int *run, *runEnd, *listEnd;
+  // for the current line: where matches end, where they start, and how far
+  // the longest from each start goes
+  unsigned char *endAt, *startAt;
+  int *ends;
+  int lineCap;
+};
+
+/*** parsing ***/
+
+typedef struct reParser {
+  const char *p;
+  reNode *nodes;
+  int n, cap;
+  edRegex *re;
+  const char *err;
+} reParser;
+
+static int reNew(reParser *ps, int type, int a, int b) {
+  if (ps->n == ps->cap) {
+    ps->cap = ps->cap ? ps->cap * 2 : 32;
+    ps->nodes = realloc(ps->nodes, sizeof(reNode) * ps->cap);
+  }
+  reNode *nd = &ps->nodes[ps->n];
+  nd->type = type;
+  nd->a = a;
+  nd->b = b;
+  nd->min = nd->max = 0;
+  return ps->n++;
+}
+
+static int reNewSet(reParser *ps) {
+  edRegex *re = ps->re;
+  re->sets = realloc(re->sets, sizeof(reSet) * (re->nSets + 1));
+  memset(re->sets[re->nSets], 0, sizeof(reSet));
+  return re->nSets++;
+}
+
+static void setAdd(unsigned int *set, int c) {
+  set[c >> 5] |= 1u << (c & 31);
+}
+
+static int setHas(const unsigned int *set, int c) {
+  return (set[c >> 5] >> (c & 31)) & 1;
+}
+
+static void setAddRange(unsigned int *set, int from, int to) {
+  int c;
+  for (c = from; c <= to; c++) setAdd(set, c);
+}
+
+static int setAddEscape(unsigned int *set, int c) {
+  // \d \w \s and their negations. returns 0 if c isn't one of them
+  reSet cls;
+  memset(cls, 0, sizeof(cls));
+  switch (c | 0x20) {
+    case 'd':
+      setAddRange(cls, '0', '9');
+      break;
+    case 'w':
+      setAddRange(cls, '0', '9');
+      setAddRange(cls, 'a', 'z');
+      setAddRange(cls, 'A', 'Z');
+      setAdd(cls, '_');
+      break;
+    case 's':
+      setAdd(cls, ' ');
+      setAddRange(cls, '\t', '\r');
+      break;
+    default:
+      return 0;
+  }
+
+  int i;
+  int negate = (c >= 'A' && c <= 'Z');
+  for (i = 0; i < 8; i++) set[i] |= negate ? ~cls[i] : cls[i];
+  return 1;
+}
+
+static int escapeChar(int c) {
+  // the byte an escape stands for, when it's not a class
+  switch (c) {
+    case 't': return '\t';
+    case 'n': return '\n';
+    case 'r': return '\r';
+  }
+  return c;
+}
+
+static int reAlt(reParser *ps);
+
+static int reClass(reParser *ps) {
+  // a [...] set; the [ is already eaten
+  int s = reNewSet(ps);
+  unsigned int *set = ps->re->sets[s]; // no other set is made until this one's done
+  int negate = 0;
+  if (*ps->p == '^') {
+    negate = 1;
+    ps->p++;
+  }
+
+  int first = 1;
+  while (*ps->p && (*ps->p != ']' || first)) {
+    int c = (unsigned char)*ps->p++;
+    first = 0;
+    if (c == '\\' && *ps->p) {
+      if (setAddEscape(set, *ps->p)) {
+        ps->p++;
+        continue;
+      }
+      c = escapeChar((unsigned char)*ps->p++);
+    }
+    if (ps->p[0] == '-' && ps->p[1] && ps->p[1] != ']') {
+      int to = (unsigned char)ps->p[1];
+      ps->p += 2;
+      if (to == '\\' && *ps->p) to = escapeChar((unsigned char)*ps->p++);
+      if (to < c) {
+        ps->err = "bad range in []";
+        return -1;
+      }
+      setAddRange(set, c, to);
+    } else {
+      setAdd(set, c);
+    }
+  }
+  if (*ps->p != ']') {
+    ps->err = "missing ]";
+    return -1;
+  }
+  ps->p++;
+
+  if (negate) {
+    int i;
+    for (i = 0; i < 8; i++) set[i] = ~set[i];
+  }
+  return reNew(ps, RE_SET, s, 0);
+}
+
+static int reAtom(reParser *ps) {
+  int c = (unsigned char)*ps->p++;
+  int s;
+  switch (c) {
+    case '(': {
+      int a = reAlt(ps);
+      if (a < 0) return -1;
+      if (*ps->p != ')') {
+        ps->err = "missing )";
+        return -1;
+      }
+      ps->p++;
+      return a;
+    }
+    case '[':
+      return reClass(ps);
+    case '.':
+      s = reNewSet(ps);
+      memset(ps->re->sets[s], 0xff, sizeof(reSet));
+      return reNew(ps, RE_SET, s, 0);
+    case '^':
+      return reNew(ps, RE_BOL, 0, 0);
+    case '$':
+      return reNew(ps, RE_EOL, 0, 0);
+    case '*':
+    case '+':
+    case '?':
+      ps->err = "nothing to repeat";
+      return -1;
+    case '\\':
+      if (*ps->p == '\0') {
+        ps->err = "trailing \\";
+        return -1;
+      }
+      c = (unsigned char)*ps->p++;
+      s = reNewSet(ps);
+      if (!setAddEscape(ps->re->sets[s], c)) setAdd(ps->re->sets[s], escapeChar(c));
+      return reNew(ps, RE_SET, s, 0);
+  }
+  s = reNewSet(ps);
+  setAdd(ps->re->sets[s], c);
+  return reNew(ps, RE_SET, s, 0);
+}
+
+static int reCount(reParser *ps) {
+  int n = 0;
+  while (*ps->p >= '0' && *ps->p <= '9' && n <= REGEX_MAX_INSTS)
+    n = n * 10 + (*ps->p++ - '0');
+  return n;
+}
+
+static int reRepeat(reParser *ps) {
+  int a = reAtom(ps);
+  while (a >= 0) {
+    char c = *ps->p;
+    if (c == '*' || c == '+' || c == '?') {
+      ps->p++;
+      a = reNew(ps, c == '*' ? RE_STAR : c == '+' ? RE_PLUS : RE_QUEST, a, 0);
+    } else if (c == '{' && ps->p[1] >= '0' && ps->p[1] <= '9') {
+      ps->p++;
+      int min = reCount(ps);
+      int max = min;
+      if (*ps->p == ',') {
+        ps->p++;
+        max = (*ps->p == '}') ? -1 : reCount(ps);
+      }
+      if (*ps->p != '}' || (max != -1 && max < min)) {
+        ps->err = "bad {m,n}";
+        return -1;
+      }
+      ps->p++;
+      a = reNew(ps, RE_REP, a, 0);
+      ps->nodes[a].min = min;
+      ps->nodes[a].max = max;
+    } else {
+      break;
+    }
+  }
+  return a;
+}
+
+static int reCat(reParser *ps) {
+  int l = -1;
+  while (*ps->p && *ps->p != '|' && *ps->p != ')') {
+    int r = reRepeat(ps);
+    if (r < 0) return -1;
+    l = (l < 0) ? r : reNew(ps, RE_CAT, l, r);
+  }
+  return (l < 0) ? reNew(ps, RE_EMPTY, 0, 0) : l;
+}
+
+static int reAlt(reParser *ps) {
+  int l = reCat(ps);
+  while (l >= 0 && *ps->p == '|') {
+    ps->p++;
+    int r = reCat(ps);
+    if (r < 0) return -1;
+    l = reNew(ps, RE_ALT, l, r);
+  }
+  return l;
+}
+
+static int reNullable(reParser *ps, int i) {
+  // can node i match without using up a byte?
+  reNode *nd = &ps->nodes[i];
+  switch (nd->type) {
+    case RE_SET: return 0;
+    case RE_CAT: return reNullable(ps, nd->a) && reNullable(ps, nd->b);
+    case RE_ALT: return reNullable(ps, nd->a) || reNullable(ps, nd->b);
+    case RE_PLUS: return reNullable(ps, nd->a);
+    case RE_REP: return nd->min == 0 || reNullable(ps, nd->a);
+  }
+  return 1;
+}
+
+/*** compiling ***/
+
+static int emit(reProg *pr, int op, int x, int y) {
+  if (pr->n == pr->cap) {
+    pr->cap = pr->cap ? pr->cap * 2 : 64;
+    pr->inst = realloc(pr->inst, sizeof(reInst) * pr->cap);
+  }
+  pr->inst[pr->n].op = op;
+  pr->inst[pr->n].x = x;
+  pr->inst[pr->n].y = y;
+  return pr->n++;
+}
+
+static int reEmit(reParser *ps, reProg *pr, int i, int backwards) {
+  // appends node i to the program, with concatenations flipped when
+  // backwards. returns 0 once the program gets too big
+  reNode nd = ps->nodes[i];
+  int l1, l2, k;
+  if (pr->n > REGEX_MAX_INSTS) return 0;
+
+  switch (nd.type) {
+    case RE_EMPTY:
+      return 1;
+    case RE_SET:
+      emit(pr, OP_SET, nd.a, 0);
+      return 1;
+    case RE_BOL:
+      emit(pr, OP_BOL, 0, 0);
+      return 1;
+    case RE_EOL:
+      emit(pr, OP_EOL, 0, 0);
+      return 1;
+    case RE_CAT:
+      return reEmit(ps, pr, backwards ? nd.b : nd.a, backwards) &&
+             reEmit(ps, pr, backwards ? nd.a : nd.b, backwards);
+    case RE_ALT:
+      l1 = emit(pr, OP_SPLIT, 0, 0);
+      pr->inst[l1].x = pr->n;
+      if (!reEmit(ps, pr, nd.a, backwards)) return 0;
+      l2 = emit(pr, OP_JMP, 0, 0);
+      pr->inst[l1].y = pr->n;
+      if (!reEmit(ps, pr, nd.b, backwards)) return 0;
+      pr->inst[l2].x = pr->n;
+      return 1;
+    case RE_STAR:
+      l1 = emit(pr, OP_SPLIT, 0, 0);
+      pr->inst[l1].x = pr->n;
+      if (!reEmit(ps, pr, nd.a, backwards)) return 0;
+      emit(pr, OP_JMP, l1, 0);
+      pr->inst[l1].y = pr->n;
+      return 1;
+    case RE_PLUS:
+      l1 = pr->n;
+      if (!reEmit(ps, pr, nd.a, backwards)) return 0;
+      emit(pr, OP_SPLIT, l1, pr->n + 1);
+      return 1;
+    case RE_QUEST:
+      l1 = emit(pr, OP_SPLIT, 0, 0);
+      pr->inst[l1].x = pr->n;
+      if (!reEmit(ps, pr, nd.a, backwards)) return 0;
+      pr->inst[l1].y = pr->n;
+      return 1;
+    case RE_REP:
+      // spelled out: min copies, then max - min optional ones (or a star)
+      for (k = 0; k < nd.min; k++)
+        if (!reEmit(ps, pr, nd.a, backwards)) return 0;
+      if (nd.max == -1) {
+        ps->nodes[i].type = RE_STAR;
+        k = reEmit(ps, pr, i, backwards);
+        ps->nodes[i].type = RE_REP;
+        return k;
+      }
+      for (k = nd.min; k < nd.max; k++) {
+        l1 = emit(pr, OP_SPLIT, 0, 0);
+        pr->inst[l1].x = pr->n;
+        if (!reEmit(ps, pr, nd.a, backwards)) return 0;
+        pr->inst[l1].y = pr->n;
+      }
+      return 1;
+  }
+  return 1;
+}
+
+static int reCompileProg(reParser *ps, reProg *pr, int root, int backwards) {
+  // 0: split 1, 3  1: any  2: jmp 0  3: the pattern  then: match
+  emit(pr, OP_SPLIT, 1, ANCHORED);
+  emit(pr, OP_ANY, 0, 0);
+  emit(pr, OP_JMP, UNANCHORED, 0);
+  if (!reEmit(ps, pr, root, backwards) || pr->n > REGEX_MAX_INSTS) return 0;
+  emit(pr, OP_MATCH, 0, 0);
+  return 1;
+}
+
+edRegex *edRegexCompile(const char *pat, const char **err) {
+  edRegex *re = calloc(1, sizeof(edRegex));
+  reParser ps = {pat, NULL, 0, 0, re, NULL};
+
+  int root = reAlt(&ps);
+  if (root >= 0 && *ps.p == ')') ps.err = "unmatched )";
+  if (root >= 0 && !ps.err && reNullable(&ps, root)) ps.err = "pattern matches empty text";
+  if (!ps.err && (!reCompileProg(&ps, &re->fwd, root, 0) ||
+                  !reCompileProg(&ps, &re->rev, root, 1)))
+    ps.err = "pattern too big";
+
+  free(ps.nodes);
+  if (ps.err) {
+    if (err) *err = ps.err;
+    edRegexFree(re);
+    return NULL;
+  }
+  return re;
+}
+
+void edRegexFree(edRegex *re) {
+  if (re == NULL) return;
+  free(re->sets);
+  free(re->fwd.inst);
+  free(re->rev.inst);
+  free(re);
+}
+
+/*** the dfa ***/
+
+static int cacheState(edDFA *d, reCache *c, int n);
+
+static void cacheReset(edDFA *d, reCache *c) {
+  // forget every state, then add back the empty one as state 0
+  c->nStates = 0;
+  c->nPcs = 0;
+  memset(c->hash, -1, sizeof(int) * (c->hashMask + 1));
+  c->start = -1;
+  c->accelState = -1;
+  c->resets++;
+  cacheState(d, c, 0);
+}
+
+static void cacheInit(edDFA *d, reCache *c, reProg *prog) {
+  memset(c, 0, sizeof(reCache));
+  c->prog = prog;
+  c->hashMask = REGEX_MAX_STATES * 2 - 1;
+  c->hash = malloc(sizeof(int) * (c->hashMask + 1));
+  c->capPcs = 64;
+  c->pcs = malloc(sizeof(int) * c->capPcs);
+  cacheReset(d, c);
+}
+
+static void cacheFree(reCache *c) {
+  free(c->trans);
+  free(c->match);
+  free(c->setOff);
+  free(c->setLen);
+  free(c->pcs);
+  free(c->hash);
+}
+
+edDFA *edDFANew(edRegex *re) {
+  edDFA *d = calloc(1, sizeof(edDFA));
+  d->re = re;
+  int n = re->fwd.n > re->rev.n ? re->fwd.n : re->rev.n;
+  d->mark = calloc(n, sizeof(int));
+  d->list = malloc(sizeof(int) * n);
+  d->stack = malloc(sizeof(int) * n);
+  d->run = malloc(sizeof(int) * n);
+  d->runEnd = malloc(sizeof(int) * n);
+  d->listEnd = malloc(sizeof(int) * n);
+
+  cacheInit(d, &d->fwd, &re->fwd);
+  return d;
+}
+
+void edDFAFree(edDFA *d) {
+  if (d == NULL) return;
+  cacheFree(&d->fwd);
+  free(d->mark);
+  free(d->list);
+  free(d->stack);
+  free(d->run);
+  free(d->runEnd);
+  free(d->listEnd);
+  free(d->endAt);
+  free(d->startAt);
+  free(d->ends);
+  free(d);
+}
+
+static int closureAdd(edDFA *d, reProg *pr, int pc, int n) {
+  // adds pc and everything it jumps to without using up a symbol to the set
+  // in d->list, which holds n entries. returns the new count
+  int top = 0;
+  d->stack[top++] = pc;
+  while (top) {
+    pc = d->stack[--top];
+    if (d->mark[pc] == d->gen) continue;
+    d->mark[pc] = d->gen;
+
+    reInst *in = &pr->inst[pc];
+    if (in->op == OP_JMP) {
+      d->stack[top++] = in->x;
+    } else if (in->op == OP_SPLIT) {
+      d->stack[top++] = in->y;
+      d->stack[top++] = in->x;
+    } else {
+      d->list[n++] = pc;
+    }
+  }
+  return n;
+}
+
+static void closureBegin(edDFA *d) {
+  if (++d->gen == 0) {
+    // wrapped around: stale marks could look current
+    int n = d->re->fwd.n > d->re->rev.n ? d->re->fwd.n : d->re->rev.n;
+    memset(d->mark, 0, sizeof(int) * n);
+    d->gen = 1;
+  }
+}
+
+static int cmpInt(const void *a, const void *b) {
+  return *(const int *)a - *(const int *)b;
+}
+
+static unsigned int setHash(const int *pcs, int n) {
+  unsigned int h = 2166136261u;
+  int i;
+  for (i = 0; i < n; i++) h = (h ^ (unsigned int)pcs[i]) * 16777619u;
+  return h;
+}
+
+static int cacheState(edDFA *d, reCache *c, int n) {
+  // the state for the n instructions in d->list, added if it's new
+  qsort(d->list, n, sizeof(int), cmpInt);
+  unsigned int h = setHash(d->list, n) & c->hashMask;
+  while (c->hash[h] >= 0) {
+    int s = c->hash[h];
+    if (c->setLen[s] == n && !memcmp(&c->pcs[c->setOff[s]], d->list, sizeof(int) * n))
+      return s;
+    h = (h + 1) & c->hashMask;
+  }
+
+  if (c->nStates == REGEX_MAX_STATES) {
+    // a pattern with more states than this is rare; start over rather than
+    // grow without bound
+    int *pcs = malloc(sizeof(int) * (n ? n : 1));
+    memcpy(pcs, d->list, sizeof(int) * n);
+    cacheReset(d, c);
+    memcpy(d->list, pcs, sizeof(int) * n);
+    free(pcs);
+    return cacheState(d, c, n);
+  }
+
+  if (c->nStates == c->cap) {
+    c->cap = c->cap ? c->cap * 2 : 16;
+    c->trans = realloc(c->trans, sizeof(int) * SYMS * c->cap);
+    c->match = realloc(c->match, c->cap);
+    c->setOff = realloc(c->setOff, sizeof(int) * c->cap);
+    c->setLen = realloc(c->setLen, sizeof(int) * c->cap);
+  }
+  if (c->nPcs + n > c->capPcs) {
+    c->capPcs = (c->nPcs + n) * 2;
+    c->pcs = realloc(c->pcs, sizeof(int) * c->capPcs);
+  }
+
+  int s = c->nStates++;
+  memset(&c->trans[s * SYMS], -1, sizeof(int) * SYMS);
+  c->setOff[s] = c->nPcs;
+  c->setLen[s] = n;
+  memcpy(&c->pcs[c->nPcs], d->list, sizeof(int) * n);
+  c->nPcs += n;
+
+  c->match[s] = 0;
+  int i;
+  for (i = 0; i < n; i++)
+    if (c->prog->inst[d->list[i]].op == OP_MATCH) c->match[s] = 1;
+
+  c->hash[h] = s;
+  return s;
+}
+
+static int instTakes(edDFA *d, reInst *in, int sym) {
+  // does in use up sym and go on?
+  switch (in->op) {
+    case OP_SET: return sym < 256 && setHas(d->re->sets[in->x], sym);
+    case OP_ANY: return 1;
+    case OP_BOL: return sym == SYM_BOL;
+    case OP_EOL: return sym == SYM_EOL;
+  }
+  return 0;
+}
+
+static int stepList(edDFA *d, reCache *c, const int *pcs, int nPcs, int sym, int n) {
+  // adds to d->list where the instructions in pcs go on sym
+  reProg *pr = c->prog;
+  int first = n;
+  int i;
+  for (i = 0; i < nPcs; i++)
+    if (instTakes(d, &pr->inst[pcs[i]], sym)) n = closureAdd(d, pr, pcs[i] + 1, n);
+
+  // ^ and $ take no room, so one line start or end gets past any run of them
+  if (sym >= 256) {
+    int op = (sym == SYM_BOL) ? OP_BOL : OP_EOL;
+    for (i = first; i < n; i++)
+      if (pr->inst[d->list[i]].op == op) n = closureAdd(d, pr, d->list[i] + 1, n);
+  }
+  return n;
+}
+
+static int dfaStep(edDFA *d, reCache *c, int s, int sym) {
+  // works out (and remembers) where state s goes on sym
+  int t = c->trans[s * SYMS + sym];
+  if (t >= 0) return t;
+  if (t <= -2) return -2 - t;
+
+  // the state's instructions may move if the cache is reset, so copy them
+  int nPcs = c->setLen[s];
+  int *pcs = malloc(sizeof(int) * (nPcs ? nPcs : 1));
+  memcpy(pcs, &c->pcs[c->setOff[s]], sizeof(int) * nPcs);
+
+  closureBegin(d);
+  int n = stepList(d, c, pcs, nPcs, sym, 0);
+  unsigned int resets = c->resets;
+  t = cacheState(d, c, n);
+  free(pcs);
+
+  // s is gone if the cache was reset to make room for t
+  if (c->resets == resets) c->trans[s * SYMS + sym] = c->match[t] ? -2 - t : t;
+  return t;
+}
+
+static int dfaStart(edDFA *d, reCache *c) {
+  // the unanchored start state
+  if (c->start >= 0) return c->start;
+
+  closureBegin(d);
+  c->start = cacheState(d, c, closureAdd(d, c->prog, UNANCHORED, 0));
+  return c->start;
+}
+
+static void dfaAccelInit(edDFA *d, reCache *c) {
+  // works out every byte's step from the start state, to see how few of
+  // them go anywhere else
+  int s = dfaStart(d, c);
+  unsigned int resets = c->resets;
+  int n = 0;
+  int b;
+  for (b = 0; b < 256; b++) {
+    int t = dfaStep(d, c, s, b);
+    if (c->resets != resets) break; // no room; try again after the next reset
+    if (t != s && n++ < 3) c->accel[n - 1] = b;
+  }
+
+  c->accelState = -2;
+  if (b == 256 && n <= 3) {
+    c->accelState = s;
+    c->nAccel = n;
+  }
+}
+
+static int dfaSkip(reCache *c, const unsigned char *s, int i, int len) {
+  // the first byte from i on that leads out of the start state, or len
+  if (c->nAccel == 0) return len;
+  if (c->nAccel == 1) {
+    const unsigned char *p = memchr(&s[i], c->accel[0], len - i);
+    return p ? p - s : len;
+  }
+
+  unsigned char b0 = c->accel[0], b1 = c->accel[1];
+  unsigned char b2 = c->nAccel == 3 ? c->accel[2] : b1;
+#if defined(__SSE2__)
+  const __m128i v0 = _mm_set1_epi8(b0);
+  const __m128i v1 = _mm_set1_epi8(b1);
+  const __m128i v2 = _mm_set1_epi8(b2);
+  for (; i + 16 <= len; i += 16) {
+    __m128i x = _mm_loadu_si128((const __m128i *)&s[i]);
+    __m128i hit = _mm_or_si128(_mm_cmpeq_epi8(x, v0),
+                               _mm_or_si128(_mm_cmpeq_epi8(x, v1), _mm_cmpeq_epi8(x, v2)));
+    unsigned int mask = _mm_movemask_epi8(hit);
+    if (mask) return i + __builtin_ctz(mask);
+  }
+#endif
+  for (; i < len; i++)
+    if (s[i] == b0 || s[i] == b1 || s[i] == b2) return i;
+  return len;
+}
+
+#define STEP(c, s, sym) \
+  ((c)->trans[(s) * SYMS + (sym)] >= 0 ? (c)->trans[(s) * SYMS + (sym)] \
+                                       : dfaStep(d, (c), (s), (sym)))
+
+static int dfaMarkEnds(edDFA *d, const unsigned char *s, int len) {
+  // marks in d->endAt every place a match ends, and returns whether there
+  // are any. most lines have none, and leave d->endAt as it was
+  reCache *c = &d->fwd;
+  if (c->accelState == -1) dfaAccelInit(d, c);
+  int any = 0;
+  int st = dfaStart(d, c);
+  st = STEP(c, st, SYM_BOL);
+
+  int i = 0;
+  while (i < len) {
+    // nearly every byte is a known step to a state that doesn't match
+    const int *trans = c->trans;
+    int t;
+    while (i < len && (t = trans[st * SYMS + s[i]]) >= 0) {
+      st = t;
+      i++;
+      if (st == c->accelState) i = dfaSkip(c, s, i, len);
+    }
+    if (i == len) break;
+
+    st = dfaStep(d, c, st, s[i++]);
+    if (c->match[st]) {
+      if (!any) memset(d->endAt, 0, len + 1);
+      d->endAt[i] = any = 1;
+    }
+  }
+  st = STEP(c, st, SYM_EOL);
+  if (c->match[st]) {
+    if (!any) memset(d->endAt, 0, len + 1);
+    d->endAt[len] = any = 1;
+  }
+  return any;
+}
+
+static int runStep(edDFA *d, reProg *pr, int n, int sym) {
+  // moves the n threads in d->list past sym, each keeping its end. they're in
+  // order of end, latest first, so where two meet the first there wins: from
+  // there on they'd match the same, and the later end makes the longer match
+  int *t = d->run;
+  d->run = d->list;
+  d->list = t;
+  t = d->runEnd;
+  d->runEnd = d->listEnd;
+  d->listEnd = t;
+
+  closureBegin(d);
+  int m = 0;
+  int i, j;
+  for (i = 0; i < n; i++) {
+    if (!instTakes(d, &pr->inst[d->run[i]], sym)) continue;
+    int from = m;
+    m = closureAdd(d, pr, d->run[i] + 1, m);
+    // ^ and $ take no room, so one line start or end gets past any run of them
+    if (sym >= 256) {
+      int op = (sym == SYM_BOL) ? OP_BOL : OP_EOL;
+      for (j = from; j < m; j++)
+        if (pr->inst[d->list[j]].op == op) m = closureAdd(d, pr, d->list[j] + 1, m);
+    }
+    for (j = from; j < m; j++) d->listEnd[j] = d->runEnd[i];
+  }
+  return m;
+}
+
+static int runAdd(edDFA *d, reProg *pr, int n, int end) {
+  // a thread for a match ending at end, behind the n in d->list
+  if (n == 0) closureBegin(d);
+  int m = closureAdd(d, pr, ANCHORED, n);
+  while (n < m) d->listEnd[n++] = end;
+  return m;
+}
+
+static int runMatch(edDFA *d, reProg *pr, int n) {
+  // the latest end a thread has got all the way back from, or -1
+  int i;
+  for (i = 0; i < n; i++)
+    if (pr->inst[d->list[i]].op == OP_MATCH) return d->listEnd[i];
+  return -1;
+}
+
+static void dfaEnds(edDFA *d, const unsigned char *s, int len) {
+  // the longest match from every start in s, from one pass backwards through
+  // the pattern backwards. a thread is started at every place a match ends,
+  // and a start is where one gets all the way through
+  reProg *pr = &d->re->rev;
+  memset(d->startAt, 0, len);
+  int n = 0;
+  if (d->endAt[len]) {
+    n = runAdd(d, pr, 0, len); // for a $ at the end
+    n = runStep(d, pr, n, SYM_EOL);
+    n = runAdd(d, pr, n, len);
+  }
+
+  int i = len;
+  while (i > 0) {
+    if (n == 0) {
+      // nothing under way; on to the next place a match ends
+      const unsigned char *p = memrchr(d->endAt, 1, i);
+      if (p == NULL) break;
+      i = p - d->endAt;
+      n = runAdd(d, pr, 0, i);
+      continue;
+    }
+    i--;
+    n = runStep(d, pr, n, s[i]);
+    int end = runMatch(d, pr, n);
+    if (end >= 0) {
+      d->startAt[i] = 1;
+      d->ends[i] = end;
+    }
+    if (d->endAt[i]) n = runAdd(d, pr, n, i);
+  }
+
+  if (i == 0 && n) {
+    n = runStep(d, pr, n, SYM_BOL);
+    int end = runMatch(d, pr, n);
+    if (end >= 0 && (!d->startAt[0] || end > d->ends[0])) {
+      d->startAt[0] = 1;
+      d->ends[0] = end;
+    }
+  }
+}
+
+int edRegexEach(edDFA *d, const char *s, int len, edRegexHit hit, void *arg) {
+  // a pass forwards finds where matches end, which rules out most lines. a
+  // line with some gets one pass backwards for where they start and how far
+  // the longest from each goes, and then the matches are taken from the
+  // left, each from the first start past the last
+  const unsigned char *u = (const unsigned char *)s;
+  if (len + 1 > d->lineCap) {
+    d->lineCap = len + 1;
+    d->endAt = realloc(d->endAt, d->lineCap);
+    d->startAt = realloc(d->startAt, d->lineCap);
+    d->ends = realloc(d->ends, sizeof(int) * d->lineCap);
+  }
+  if (!dfaMarkEnds(d, u, len)) return 0;
+  dfaEnds(d, u, len);
+
+  int n = 0;
+  const unsigned char *p = d->startAt;
+  while ((p = memchr(p, 1, d->startAt + len - p)) != NULL) {
+    int at = p - d->startAt;
+    hit(arg, at, d->ends[at]);
+    n++;
+    p = d->startAt + d->ends[at];
+  }
+  return n;
+}
@@ -0,0 +1,39 @@
+#ifndef REGEX_DFA_H_
+#define REGEX_DFA_H_
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE // memrchr
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+
+// longest pattern program, after {m,n} repeats are spelled out
+#define REGEX_MAX_INSTS 20000
+// dfa states kept before the cache is thrown away and rebuilt
+#define REGEX_MAX_STATES 2048
+
+// a compiled pattern. it's only read once compiled, so threads can share one,
+// each with an edDFA of its own
+typedef struct edRegex edRegex;
+// the automaton for a pattern, built lazily as text is run through it
+typedef struct edDFA edDFA;
+
+// called for each match, [start, end) of the text
+typedef void (*edRegexHit)(void *arg, int start, int end);
+
+// extended regex syntax: . [] [^] * + ? {m,n} | () ^ $ and \d \w \s (\D \W
+// \S). patterns that can match empty text are refused, so every match moves
+// the search along. on failure, err is set to what's wrong
+edRegex *edRegexCompile(const char *pat, const char **err);
+void edRegexFree(edRegex *re);
+
+edDFA *edDFANew(edRegex *re);
+void edDFAFree(edDFA *d);
+
+// reports every leftmost-longest match in s, in order, and returns how many.
+// linear in len whatever the pattern and however many matches there are: a
+// line without one is a pass of the dfa, a line with some a pass more
+int edRegexEach(edDFA *d, const char *s, int len, edRegexHit hit, void *arg);
+
+#endif // REGEX_DFA_H_
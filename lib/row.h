@@ -1,15 +1,25 @@
 #ifndef ROW_H_
 #define ROW_H_
 
+// a row's highlighting, as runs of chars that share a class: the class in the
+// low byte and the run's length above it. longer runs are split
+typedef unsigned int edHLRun;
+#define HL_RUN(cls, len) (((unsigned int)(len) << 8) | (cls))
+#define HL_RUN_CLASS(r) ((r) & 0xff)
+#define HL_RUN_LEN(r) ((int)((r) >> 8))
+#define HL_RUN_MAX 0xffffff
+
 // represents a row of text in a file to be displayed.
+// tabs are kept as they are, and expanded only when drawn.
+// both arrays come from the row allocator (see row_mem.h).
 typedef struct edRow {
   int size;
-  int rSize;
-  int rowInd;
+  int cap; // bytes chars has room for, '\0' included
   int hlOpenComment;
-  char *render;
+  int nHL;
+  int disk; // the line of the file on disk it's the same as, -1 once changed
   char *chars;
-  unsigned char *hl;
+  edHLRun *hl; // nHL runs adding up to size, NULL if it's all HL_NORMAL
 } edRow;
 
 #endif // ROW_H_
@@ -0,0 +1,132 @@
+#include "row_mem.h"
+
+// a class every half step up or so, so a chunk is at most a third slack
+static const int classSize[] = {16, 24, 32, 48, 64, 96, 128, 192, 256, 384,
+                                512, 768, 1024, 1536, 2048, 3072, 4096};
+#define N_CLASSES (int)(sizeof(classSize) / sizeof(classSize[0]))
+
+typedef struct memChunk {
+  struct memChunk *next;
+} memChunk;
+
+// a heap block of its own, linked in so edRowMemReset can find it
+typedef struct memBig {
+  struct memBig *prev, *next;
+} memBig;
+
+static struct {
+  int ready;
+  unsigned char classOf[ROW_MEM_MAX / 8 + 1]; // by size in 8 byte steps
+  memChunk *free[N_CLASSES];
+  char *next, *end; // what's left of the newest slab
+  void *slabs; // every slab, chained through their first bytes
+  memBig big; // list head
+} mem;
+
+static void memInit() {
+  int c = 0;
+  int i;
+  for (i = 0; i <= ROW_MEM_MAX / 8; i++) {
+    while (classSize[c] < i * 8) c++;
+    mem.classOf[i] = c;
+  }
+  mem.big.prev = mem.big.next = &mem.big;
+  mem.ready = 1;
+}
+
+static int memClass(int size) {
+  return mem.classOf[(size + 7) / 8];
+}
+
+int edRowMemCap(int size) {
+  if (size > ROW_MEM_MAX) return (size + ROW_MEM_MAX - 1) & ~(ROW_MEM_MAX - 1);
+  if (!mem.ready) memInit();
+  return classSize[memClass(size)];
+}
+
+void *edRowMemAlloc(int size) {
+  if (!mem.ready) memInit();
+
+  if (size > ROW_MEM_MAX) {
+    memBig *b = malloc(sizeof(memBig) + edRowMemCap(size));
+    b->prev = &mem.big;
+    b->next = mem.big.next;
+    b->next->prev = b;
+    mem.big.next = b;
+    return b + 1;
+  }
+
+  int c = memClass(size);
+  memChunk *ch = mem.free[c];
+  if (ch) {
+    mem.free[c] = ch->next;
+    return ch;
+  }
+
+  // carve it off the newest slab. what a slab can't fit is left unused
+  if (mem.end - mem.next < classSize[c]) {
+    char *slab = malloc(ROW_MEM_SLAB);
+    *(void **)slab = mem.slabs;
+    mem.slabs = slab;
+    mem.next = slab + 16;
+    mem.end = slab + ROW_MEM_SLAB;
+  }
+  ch = (memChunk *)mem.next;
+  mem.next += classSize[c];
+  return ch;
+}
+
+void *edRowMemResize(void *p, int old, int size) {
+  if (p == NULL) return edRowMemAlloc(size);
+
+  if (old > ROW_MEM_MAX && size > ROW_MEM_MAX) {
+    memBig *b = realloc((memBig *)p - 1, sizeof(memBig) + edRowMemCap(size));
+    b->prev->next = b;
+    b->next->prev = b;
+    return b + 1;
+  }
+  if (old <= ROW_MEM_MAX && size <= ROW_MEM_MAX && memClass(old) == memClass(size))
+    return p;
+
+  void *q = edRowMemAlloc(size);
+  memcpy(q, p, old < size ? old : size);
+  edRowMemFree(p, old);
+  return q;
+}
+
+void edRowMemFree(void *p, int size) {
+  if (p == NULL) return;
+
+  if (size > ROW_MEM_MAX) {
+    memBig *b = (memBig *)p - 1;
+    b->prev->next = b->next;
+    b->next->prev = b->prev;
+    free(b);
+    return;
+  }
+
+  memChunk *ch = p;
+  int c = memClass(size);
+  ch->next = mem.free[c];
+  mem.free[c] = ch;
+}
+
+void edRowMemReset() {
+  // every row is gone: hand back all the slabs rather than chunk by chunk
+  if (!mem.ready) return;
+
+  while (mem.slabs) {
+    void *next = *(void **)mem.slabs;
+    free(mem.slabs);
+    mem.slabs = next;
+  }
+  while (mem.big.next != &mem.big) {
+    memBig *b = mem.big.next;
+    mem.big.next = b->next;
+    free(b);
+  }
+  mem.big.prev = &mem.big;
+
+  memset(mem.free, 0, sizeof(mem.free));
+  mem.next = mem.end = NULL;
+}
@@ -0,0 +1,24 @@
+#ifndef ROW_MEM_H_
+#define ROW_MEM_H_
+
+#include <stdlib.h>
+#include <string.h>
+
+// rows' chars and hl come out of big slabs, one list of them per size class,
+// instead of a heap block each. freed chunks are reused by their class, and
+// the whole lot goes back in one go when the file is closed (edRowMemReset).
+// anything past ROW_MEM_MAX is a heap block of its own.
+// only ever used with E.lock held.
+#define ROW_MEM_SLAB (64 << 10)
+#define ROW_MEM_MAX 4096
+
+// what an allocation of size bytes really holds, so a row can grow into it
+int edRowMemCap(int size);
+void *edRowMemAlloc(int size);
+// moves p (of size or cap bytes, either will do) to a chunk that holds size,
+// unless it already does
+void *edRowMemResize(void *p, int old, int size);
+void edRowMemFree(void *p, int size);
+void edRowMemReset();
+
+#endif // ROW_MEM_H_
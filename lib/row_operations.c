@@ -1,137 +1,225 @@
 #include "row_operations.h"
 
 void edUpdateRow(edRow *row) {
-  // handles rendering the tabs based on the given chars
-  int tabs = 0;
-  int j;
-  for (j = 0; j < row->size; j++) {
-    if (row->chars[j] == '\t')
-      tabs++;
-  }
+  edUpdateHL(row);
+}
 
-  free(row->render);
+static void rowReserve(edRow *row, int size) {
+  // room for size bytes of chars. rows grow into the slack of their chunk
+  // first, and then by at least half again, so growing one char at a time
+  // only copies the row now and then
+  if (size <= row->cap) return;
+  if (size < row->cap + row->cap / 2) size = row->cap + row->cap / 2;
+  row->chars = edRowMemResize(row->chars, row->cap, size);
+  row->cap = edRowMemCap(size);
+}
 
-  // row->size counts 1 per tab, so multiply tabs by 7 (assumes 8 spaces per tab)
-  row->render = malloc(row->size + tabs * (TAB_STOP - 1) + 1);
+void edInitRow(edRow *row, char *s, size_t len) {
+  // fill in a fresh row; hl is left for edUpdateRow
+  row->size = len;
+  row->cap = edRowMemCap(len + 1);
+  row->chars = edRowMemAlloc(len + 1);
+  memcpy(row->chars, s, len);
+  row->chars[len] = '\0';
 
-  int i = 0;
-  for (j = 0; j < row->size; j++) {
-    if (row->chars[j] == '\t') {
-      row->render[i++] = ' ';
-      while (i % TAB_STOP != 0) row->render[i++] = ' ';
-    } else {
-      row->render[i++] = row->chars[j];
-    }
-  }
+  row->hl = NULL;
+  row->nHL = 0;
+  row->disk = -1;
 
-  row->render[i] = '\0';
-  row->rSize = i;
+  row->hlOpenComment = 0;
+}
 
-  edUpdateHL(row);
+void edCopyRow(edRow *dst, edRow *src) {
+  // a row of its own with the same text and hl as src
+  edInitRow(dst, src->chars, src->size);
+  dst->hlOpenComment = src->hlOpenComment;
+  dst->disk = src->disk;
+  if (src->hl) {
+    dst->nHL = src->nHL;
+    dst->hl = edRowMemAlloc(sizeof(edHLRun) * src->nHL);
+    memcpy(dst->hl, src->hl, sizeof(edHLRun) * src->nHL);
+  }
 }
 
 void edInsertRow(int a, char *s, size_t len) {
   if (a < 0 || a > E.nRows) return;
 
-  E.row = realloc(E.row, sizeof(edRow) * (E.nRows + 1));
-  memmove(&E.row[a + 1], &E.row[a], sizeof(edRow) * (E.nRows - a));
+  // only the rows sharing a's block get shifted
+  edRow *row = edStoreInsert(a);
+  E.nRows++;
+  edHLInsert(a, 1);
 
-  // update each displaced row
-  for (int j = a + 1; j <= E.nRows; j++) E.row[j].rowInd++;
+  edInitRow(row, s, len);
+  edUpdateRow(row);
+  edJournal(JOURNAL_ROW, a, 0, s, len);
+  edUndoRecord(JOURNAL_ROW, a, 0, s, len);
 
-  E.row[a].size = len;
-  E.row[a].chars = malloc(len + 1);
-  memcpy(E.row[a].chars, s, len);
-  E.row[a].chars[len] = '\0';
+  E.dirty++;
+  E.version++;
+}
 
-  E.row[a].rSize = 0;
-  E.row[a].render = NULL;
-  E.row[a].hl = NULL;
+static int lineEnd(char *s, size_t len, size_t from, size_t *next) {
+  // where the line starting at from ends, and where the one after it starts.
+  // a paste can end its lines in '\r', '\n' or both
+  size_t end = from;
+  while (end < len && s[end] != '\r' && s[end] != '\n') end++;
+  *next = end + 1;
+  if (end < len && s[end] == '\r' && end + 1 < len && s[end + 1] == '\n') (*next)++;
+  return end;
+}
 
-  E.row[a].rowInd = a;
-  E.row[a].hlOpenComment = 0;
-  edUpdateRow(&E.row[a]);
+int edInsertLines(int at, char *s, size_t len) {
+  // every line of s as a row, from at on. the rows are all made in one go,
+  // and highlighted later along with the rest. returns how many there are
+  if (at < 0 || at > E.nRows) return 0;
+
+  int n = 0;
+  size_t p = 0;
+  do {
+    lineEnd(s, len, p, &p);
+    n++;
+  } while (p <= len);
+
+  edStoreInsertRows(at, n);
+  E.nRows += n;
+  edHLInsert(at, n);
+
+  int i;
+  p = 0;
+  for (i = 0; i < n; i++) {
+    size_t next;
+    size_t end = lineEnd(s, len, p, &next);
+    edInitRow(edRowAt(at + i), &s[p], end - p);
+    p = next;
+  }
+  edJournal(JOURNAL_LINES, at, 0, s, len);
+  edUndoRecord(JOURNAL_LINES, at, n, s, len);
 
-  E.nRows++;
   E.dirty++;
+  E.version++;
+  return n;
 }
 
-
 int edComputeRx(edRow *row, int cX) {
+  // tabs are the only chars wider than a column, so hop from tab to tab
   int rX = 0;
-  int j;
-  for (j = 0; j < cX; j++) {
-    if (row->chars[j] == '\t') {
-      //# cols to the left we are from the next tab_stop
-      rX += (TAB_STOP - 1) - (rX % TAB_STOP);
-    }
-    rX++; //puts us right on top of the next tab_stop
+  int j = 0;
+  while (j < cX) {
+    const char *tab = memchr(&row->chars[j], '\t', cX - j);
+    if (tab == NULL) return rX + (cX - j);
+
+    int k = tab - row->chars;
+    rX += k - j;
+    rX += TAB_STOP - (rX % TAB_STOP); // puts us right on top of the next tab_stop
+    j = k + 1;
   }
 
   return rX;
 }
 
 int edComputeCx(edRow *row, int rX) {
+  // the char drawn at column rX (or row->size, past the end)
   int rX_t = 0;
-  int cX;
-  for (cX = 0; cX < row->size; cX++) {
-    if (row->chars[cX] == '\t')
-      rX_t += (TAB_STOP - 1) - (rX_t % TAB_STOP);
-    rX_t++;
-
+  int cX = 0;
+  while (cX < row->size) {
+    const char *tab = memchr(&row->chars[cX], '\t', row->size - cX);
+    int k = tab ? tab - row->chars : row->size;
+
+    // one column per char up to the tab
+    if (rX_t + (k - cX) > rX) return cX + (rX - rX_t);
+    rX_t += k - cX;
+    cX = k;
+    if (tab == NULL) break;
+
+    rX_t += TAB_STOP - (rX_t % TAB_STOP);
     if (rX_t > rX) return cX;
+    cX++;
   }
   return cX;
 }
 
 void edRowInsertChar(edRow *row, int at, int c) {
+  char ch = c;
+  edRowInsertStr(row, at, &ch, 1);
+}
+
+void edRowInsertStr(edRow *row, int at, char *s, size_t len) {
+  // the whole span goes in with one move of the rest of the row, and the row
+  // is only redone once
   if (at < 0 || at > row->size) at = row->size;
-  row->chars = realloc(row->chars, row->size + 2);
+  rowReserve(row, row->size + len + 1);
 
-  // make space for the new char at spot at
-  memmove(&row->chars[at + 1], &row->chars[at], row->size - at + 1);
-  row->size++;
-  row->chars[at] = c;
+  // make space for the new chars at spot at
+  memmove(&row->chars[at + len], &row->chars[at], row->size - at + 1);
+  memcpy(&row->chars[at], s, len);
+  row->size += len;
+  row->disk = -1;
+  if (edJournalOn() || edUndoOn()) {
+    int y = edRowIndex(row);
+    edJournal(JOURNAL_INSERT, y, at, s, len);
+    edUndoRecord(JOURNAL_INSERT, y, at, s, len);
+  }
 
-  // update render/rsize fields
   edUpdateRow(row);
   E.dirty++;
+  E.version++;
 }
 
 void edRowRemoveChar(edRow *row, int at) {
+  edRowDeleteStr(row, at, 1);
+}
+
+void edRowDeleteStr(edRow *row, int at, int len) {
+  if (at < 0 || at >= row->size || len <= 0) return;
+  if (len > row->size - at) len = row->size - at;
+  int y = edJournalOn() || edUndoOn() ? edRowIndex(row) : -1;
+  edUndoRecord(JOURNAL_REMOVE, y, at, &row->chars[at], len);
+
+  // overwrite the len chars from index at with the rest of the row
+  memmove(&row->chars[at], &row->chars[at + len], row->size - at - len + 1);
+  row->size -= len;
+  row->disk = -1;
+  edJournal(JOURNAL_REMOVE, y, at, NULL, len);
+  edUpdateRow(row);
+  E.dirty++;
+  E.version++;
+}
+
+void edRowTruncate(edRow *row, int at) {
+  // drops everything from at on
   if (at < 0 || at >= row->size) return;
+  int y = edJournalOn() || edUndoOn() ? edRowIndex(row) : -1;
+  edUndoRecord(JOURNAL_TRUNCATE, y, at, &row->chars[at], row->size - at);
 
-  // overwrite the char at index at
-  memmove(&row->chars[at], &row->chars[at + 1], row->size - at);
-  row->size--;
+  row->size = at;
+  row->chars[at] = '\0';
+  row->disk = -1;
+  edJournal(JOURNAL_TRUNCATE, y, at, NULL, 0);
   edUpdateRow(row);
   E.dirty++;
+  E.version++;
 }
 
 void edFreeRow(edRow *row) {
-  free(row->render);
-  free(row->chars);
-  free(row->hl);
+  edRowMemFree(row->chars, row->cap);
+  edRowMemFree(row->hl, sizeof(edHLRun) * row->nHL);
 }
 
 void edDeleteRow(int at) {
   if (at < 0 || at >= E.nRows) return;
-  edFreeRow(&E.row[at]);
-
-  // delete the current row, shift the rows under it up by 1
-  memmove(&E.row[at], &E.row[at + 1], sizeof(edRow) * (E.nRows - at - 1));
+  edRow *row = edRowAt(at);
+  edUndoRecord(JOURNAL_DELETE, at, 0, row->chars, row->size);
+  edFreeRow(row);
 
-  // update each displaced row
-  for (int j = at; j < E.nRows - 1; j++) E.row[j].rowInd--;
+  // delete the current row, shift the rows under it (in its block) up by 1
+  edStoreDelete(at);
   E.nRows--;
+  edHLDelete(at);
+  edJournal(JOURNAL_DELETE, at, 0, NULL, 0);
   E.dirty++;
+  E.version++;
 }
 
 void edRowAppendStr(edRow *row, char *s, size_t len) {
-  row->chars = realloc(row->chars, row->size + len + 1);
-  memcpy(&row->chars[row->size], s, len);
-  row->size += len;
-  row->chars[row->size] = '\0';
-  edUpdateRow(row);
-  E.dirty++;
+  edRowInsertStr(row, row->size, s, len);
 }
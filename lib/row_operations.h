@@ -5,17 +5,26 @@
 #include <string.h>
 
 #include "constants.h"
+#include "journal.h"
 #include "row.h"
+#include "row_mem.h"
 #include "syntax_highlighting.h"
+#include "undo.h"
 
 
+void edInitRow(edRow *row, char *s, size_t len);
+void edCopyRow(edRow *dst, edRow *src);
 void edInsertRow(int a, char *s, size_t len);
-void edUpdateRow(edRow *row); //help us handle tabs
+int edInsertLines(int at, char *s, size_t len);
+void edUpdateRow(edRow *row);
 void edDeleteRow(int at);
+void edRowDeleteStr(edRow *row, int at, int len);
+void edRowTruncate(edRow *row, int at);
 void edFreeRow(edRow *row);
 int edComputeRx(edRow *row, int cX);
 int edComputeCx(edRow *row, int rX);
 void edRowInsertChar(edRow *row, int at, int c);
+void edRowInsertStr(edRow *row, int at, char *s, size_t len);
 void edRowRemoveChar(edRow *row, int at);
 void edRowAppendStr(edRow *row, char *s, size_t len);
 
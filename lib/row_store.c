@@ -0,0 +1,496 @@
+#include "row_store.h"
+#include "editor_configs.h"
+#include "row_operations.h"
+
+/*** fenwick tree over block sizes ***/
+static void fenAdd(edRowStore *rs, int b, int d) {
+  for (b++; b <= rs->nBlocks; b += b & -b) rs->sizes[b] += d;
+}
+
+static int fenPrefix(edRowStore *rs, int b) {
+  // number of rows in blocks [0, b)
+  int sum = 0;
+  for (; b > 0; b -= b & -b) sum += rs->sizes[b];
+  return sum;
+}
+
+static void fenBuild(edRowStore *rs) {
+  int i;
+  for (i = 1; i <= rs->nBlocks; i++) rs->sizes[i] = rs->blocks[i - 1]->n;
+  for (i = 1; i <= rs->nBlocks; i++) {
+    int up = i + (i & -i);
+    if (up <= rs->nBlocks) rs->sizes[up] += rs->sizes[i];
+  }
+}
+
+static int fenFind(edRowStore *rs, int at, int *off) {
+  // descend the tree to the block holding row at
+  int b = 0;
+  int step = 1;
+  while (step * 2 <= rs->nBlocks) step *= 2;
+
+  for (; step; step >>= 1) {
+    if (b + step <= rs->nBlocks && rs->sizes[b + step] <= at) {
+      b += step;
+      at -= rs->sizes[b];
+    }
+  }
+  *off = at;
+  return b;
+}
+
+/*** blocks ***/
+static void storeReserve(edRowStore *rs, int nBlocks) {
+  if (nBlocks <= rs->cap) return;
+  if (rs->cap == 0) rs->cap = 16;
+  while (rs->cap < nBlocks) rs->cap *= 2;
+
+  rs->blocks = realloc(rs->blocks, sizeof(edRowBlock *) * rs->cap);
+  rs->sizes = realloc(rs->sizes, sizeof(int) * (rs->cap + 1));
+}
+
+static char *storeLine(int line, int *len) {
+  // text of a line in the mapped file, without its line ending
+  edFileMap *m = &E.map;
+  size_t start = m->lineOff[line];
+  size_t end = m->lineOff[line + 1] - 1;
+  while (m->hasCR && end > start && m->b[end - 1] == '\r') end--;
+
+  *len = end - start;
+  return &m->b[start];
+}
+
+static void storeMaterialize(edRowStore *rs, int b) {
+  // build the rows of a lazy block from the mapped file
+  edRowBlock *blk = rs->blocks[b];
+  if (blk->rows) return;
+
+  blk->rows = malloc(sizeof(edRow) * ROW_BLOCK_MAX);
+  int i;
+  for (i = 0; i < blk->n; i++) {
+    int len;
+    char *s = storeLine(blk->line + i, &len);
+    edInitRow(&blk->rows[i], s, len);
+    blk->rows[i].disk = blk->disk < 0 ? -1 : blk->disk + i;
+  }
+  edHLBuildBlock(blk, fenPrefix(rs, b));
+}
+
+static void storeOwn(edRowStore *rs, int b) {
+  // block b is about to change. if a snapshot still shares it, the store
+  // goes on with a copy of its own and leaves the snapshot the original
+  edRowBlock *old = rs->blocks[b];
+  if (old->refs == 1) return;
+
+  edRowBlock *blk = malloc(sizeof(edRowBlock));
+  *blk = *old;
+  blk->refs = 1;
+  old->refs--;
+  if (old->rows) {
+    blk->rows = malloc(sizeof(edRow) * ROW_BLOCK_MAX);
+    int i;
+    for (i = 0; i < blk->n; i++) edCopyRow(&blk->rows[i], &old->rows[i]);
+  }
+  rs->blocks[b] = blk;
+}
+
+static void storeAddBlock(edRowStore *rs, int b) {
+  storeReserve(rs, rs->nBlocks + 1);
+
+  edRowBlock *blk = malloc(sizeof(edRowBlock));
+  blk->n = 0;
+  blk->line = 0;
+  blk->hlOpen = 0;
+  blk->refs = 1;
+  blk->disk = -1;
+  blk->rows = malloc(sizeof(edRow) * ROW_BLOCK_MAX);
+
+  memmove(&rs->blocks[b + 1], &rs->blocks[b], sizeof(edRowBlock *) * (rs->nBlocks - b));
+  rs->blocks[b] = blk;
+  rs->nBlocks++;
+  rs->hint = -1;
+
+  if (b == rs->nBlocks - 1) {
+    // appended an empty block: only its own tree node needs filling in
+    int i = rs->nBlocks;
+    rs->sizes[i] = fenPrefix(rs, i - 1) - fenPrefix(rs, i - (i & -i));
+  } else {
+    fenBuild(rs);
+  }
+}
+
+static void storeOpenBlocks(edRowStore *rs, int b, int count) {
+  // count empty blocks at b, with a single rebuild of the tree
+  storeReserve(rs, rs->nBlocks + count);
+  memmove(&rs->blocks[b + count], &rs->blocks[b], sizeof(edRowBlock *) * (rs->nBlocks - b));
+
+  int i;
+  for (i = 0; i < count; i++) {
+    edRowBlock *blk = malloc(sizeof(edRowBlock));
+    blk->n = 0;
+    blk->line = 0;
+    blk->hlOpen = 0;
+    blk->refs = 1;
+    blk->disk = -1;
+    blk->rows = malloc(sizeof(edRow) * ROW_BLOCK_MAX);
+    rs->blocks[b + i] = blk;
+  }
+  rs->nBlocks += count;
+  fenBuild(rs);
+  rs->hint = -1;
+}
+
+static void storeRemoveBlock(edRowStore *rs, int b) {
+  free(rs->blocks[b]->rows);
+  free(rs->blocks[b]);
+
+  memmove(&rs->blocks[b], &rs->blocks[b + 1], sizeof(edRowBlock *) * (rs->nBlocks - b - 1));
+  rs->nBlocks--;
+  fenBuild(rs);
+  rs->hint = -1;
+}
+
+static void storeSplit(edRowStore *rs, int b) {
+  // move the upper half of block b into a fresh block after it
+  storeAddBlock(rs, b + 1);
+  edRowBlock *lo = rs->blocks[b];
+  edRowBlock *hi = rs->blocks[b + 1];
+
+  hi->n = lo->n / 2;
+  lo->n -= hi->n;
+  memcpy(hi->rows, &lo->rows[lo->n], sizeof(edRow) * hi->n);
+  fenBuild(rs);
+}
+
+static void storeMerge(edRowStore *rs, int b) {
+  // fold block b + 1 into block b. both change, so neither stays shared
+  storeOwn(rs, b);
+  storeOwn(rs, b + 1);
+  edRowBlock *lo = rs->blocks[b];
+  edRowBlock *hi = rs->blocks[b + 1];
+
+  memcpy(&lo->rows[lo->n], hi->rows, sizeof(edRow) * hi->n);
+  lo->n += hi->n;
+  hi->n = 0;
+  storeRemoveBlock(rs, b + 1);
+}
+
+static int storeLocate(edRowStore *rs, int at, int *off) {
+  // most lookups are for the same or the next block as the last one
+  if (rs->hint >= 0) {
+    int n = rs->blocks[rs->hint]->n;
+    if (at >= rs->hintStart && at < rs->hintStart + n) {
+      *off = at - rs->hintStart;
+      return rs->hint;
+    }
+    if (rs->hint + 1 < rs->nBlocks && at >= rs->hintStart + n &&
+        at < rs->hintStart + n + rs->blocks[rs->hint + 1]->n) {
+      rs->hintStart += n;
+      rs->hint++;
+      *off = at - rs->hintStart;
+      return rs->hint;
+    }
+  }
+
+  int b = fenFind(rs, at, off);
+  rs->hint = b;
+  rs->hintStart = at - *off;
+  return b;
+}
+
+static int storeBlockOf(edRowStore *rs, edRow *row, int b) {
+  edRowBlock *blk = rs->blocks[b];
+  return blk->rows && row >= blk->rows && row < blk->rows + blk->n;
+}
+
+/*** store ***/
+void edStoreInit(edRowStore *rs) {
+  rs->blocks = NULL;
+  rs->nBlocks = 0;
+  rs->cap = 0;
+  rs->sizes = NULL;
+  rs->hint = -1;
+  rs->hintStart = 0;
+}
+
+void edStoreFree(edRowStore *rs) {
+  // drops every row at once: their chars and hl all go back with the slabs
+  // they came from, so only the blocks are freed one by one. no snapshot may
+  // be left, as its rows go back too
+  int b;
+  for (b = 0; b < rs->nBlocks; b++) {
+    free(rs->blocks[b]->rows);
+    free(rs->blocks[b]);
+  }
+  free(rs->blocks);
+  free(rs->sizes);
+  edRowMemReset();
+  edStoreInit(rs);
+}
+
+edRow *edRowAt(int at) {
+  if (at < 0 || at >= E.nRows) return NULL;
+
+  // the row may be changed through what's returned
+  int off;
+  int b = storeLocate(&E.rows, at, &off);
+  storeOwn(&E.rows, b);
+  storeMaterialize(&E.rows, b);
+  return &E.rows.blocks[b]->rows[off];
+}
+
+edRow *edRowRead(int at) {
+  // like edRowAt, for rows that are only looked at. a block a snapshot shares
+  // is read where it is; only a lazy one gets a block of its own to be built
+  // in, which has no rows to copy
+  if (at < 0 || at >= E.nRows) return NULL;
+
+  int off;
+  int b = storeLocate(&E.rows, at, &off);
+  if (!E.rows.blocks[b]->rows) {
+    storeOwn(&E.rows, b);
+    storeMaterialize(&E.rows, b);
+  }
+  return &E.rows.blocks[b]->rows[off];
+}
+
+edRow *edRowPeek(int at) {
+  // like edRowAt, but NULL for rows that haven't been built yet
+  if (at < 0 || at >= E.nRows) return NULL;
+
+  int off;
+  int b = storeLocate(&E.rows, at, &off);
+  if (!E.rows.blocks[b]->rows) return NULL;
+  return &E.rows.blocks[b]->rows[off];
+}
+
+char *edRowChars(int at, int *len) {
+  // the text of row at, read straight from the file if it's still lazy
+  int off;
+  int b = storeLocate(&E.rows, at, &off);
+  return edBlockChars(E.rows.blocks[b], off, len);
+}
+
+char *edBlockChars(edRowBlock *blk, int off, int *len) {
+  // edRowChars for a block already in hand. it leaves the lookup hint alone,
+  // so threads can read rows side by side
+  if (!blk->rows) return storeLine(blk->line + off, len);
+  *len = blk->rows[off].size;
+  return blk->rows[off].chars;
+}
+
+edRowBlock *edRowBlockOf(int at, int *start) {
+  // the block holding row at, and the index of its first row
+  int off;
+  int b = storeLocate(&E.rows, at, &off);
+  *start = at - off;
+  return E.rows.blocks[b];
+}
+
+int edRowIndex(edRow *row) {
+  edRowStore *rs = &E.rows;
+
+  // the row was almost always just looked up, so try around the hint first
+  if (rs->hint >= 0) {
+    int b = rs->hint;
+    if (storeBlockOf(rs, row, b))
+      return rs->hintStart + (row - rs->blocks[b]->rows);
+    if (b + 1 < rs->nBlocks && storeBlockOf(rs, row, b + 1))
+      return rs->hintStart + rs->blocks[b]->n + (row - rs->blocks[b + 1]->rows);
+    if (b > 0 && storeBlockOf(rs, row, b - 1))
+      return rs->hintStart - rs->blocks[b - 1]->n + (row - rs->blocks[b - 1]->rows);
+  }
+
+  int b;
+  for (b = 0; b < rs->nBlocks; b++) {
+    if (storeBlockOf(rs, row, b)) {
+      rs->hint = b;
+      rs->hintStart = fenPrefix(rs, b);
+      return rs->hintStart + (row - rs->blocks[b]->rows);
+    }
+  }
+  return -1;
+}
+
+void edStoreLoadLazy(int nLines) {
+  // append lazy blocks covering the first nLines lines of E.map
+  edRowStore *rs = &E.rows;
+  storeReserve(rs, rs->nBlocks + (nLines + ROW_BLOCK_MAX - 1) / ROW_BLOCK_MAX);
+
+  int line;
+  for (line = 0; line < nLines; line += ROW_BLOCK_MAX) {
+    edRowBlock *blk = malloc(sizeof(edRowBlock));
+    blk->n = (nLines - line < ROW_BLOCK_MAX) ? nLines - line : ROW_BLOCK_MAX;
+    blk->line = line;
+    blk->rows = NULL;
+    blk->hlOpen = 0;
+    blk->refs = 1;
+    blk->disk = line;
+    rs->blocks[rs->nBlocks++] = blk;
+  }
+
+  fenBuild(rs);
+  rs->hint = -1;
+  E.nRows += nLines;
+}
+
+edRow *edStoreInsert(int at) {
+  // opens up an uninitialised slot for row at and returns it
+  edRowStore *rs = &E.rows;
+  int b, off;
+
+  if (rs->nBlocks == 0) storeAddBlock(rs, 0);
+
+  if (at == E.nRows) {
+    b = rs->nBlocks - 1;
+    off = rs->blocks[b]->n;
+    storeOwn(rs, b);
+    storeMaterialize(rs, b);
+
+    // appending (e.g. loading a file): start a new block instead of splitting
+    if (off == ROW_BLOCK_MAX) {
+      storeAddBlock(rs, ++b);
+      off = 0;
+    }
+  } else {
+    b = storeLocate(rs, at, &off);
+    storeOwn(rs, b);
+    storeMaterialize(rs, b);
+  }
+
+  edRowBlock *blk = rs->blocks[b];
+  if (blk->n == ROW_BLOCK_MAX) {
+    storeSplit(rs, b);
+    if (off > blk->n) {
+      off -= blk->n;
+      blk = rs->blocks[++b];
+    }
+  }
+
+  memmove(&blk->rows[off + 1], &blk->rows[off], sizeof(edRow) * (blk->n - off));
+  blk->n++;
+  fenAdd(rs, b, 1);
+
+  rs->hint = b;
+  rs->hintStart = at - off;
+  return &blk->rows[off];
+}
+
+void edStoreInsertRows(int at, int n) {
+  // opens up n uninitialised slots from row at on. if they don't fit in at's
+  // block they get blocks of their own, so at most the rest of that block is
+  // moved, however many there are
+  edRowStore *rs = &E.rows;
+  int b = 0;
+  if (rs->nBlocks > 0) {
+    int off;
+    if (at == E.nRows) {
+      b = rs->nBlocks - 1;
+      off = rs->blocks[b]->n;
+    } else {
+      b = storeLocate(rs, at, &off);
+    }
+    storeOwn(rs, b);
+    storeMaterialize(rs, b);
+    edRowBlock *blk = rs->blocks[b];
+
+    if (blk->n + n <= ROW_BLOCK_MAX) {
+      memmove(&blk->rows[off + n], &blk->rows[off], sizeof(edRow) * (blk->n - off));
+      blk->n += n;
+      fenAdd(rs, b, n);
+      rs->hint = b;
+      rs->hintStart = at - off;
+      return;
+    }
+
+    if (off > 0 && off < blk->n) {
+      // the rows from at on get a block of their own, after the new ones
+      storeOpenBlocks(rs, b + 1, 1);
+      edRowBlock *hi = rs->blocks[b + 1];
+      hi->n = blk->n - off;
+      blk->n = off;
+      memcpy(hi->rows, &blk->rows[off], sizeof(edRow) * hi->n);
+    }
+    if (off > 0) b++;
+  }
+
+  int count = (n + ROW_BLOCK_MAX - 1) / ROW_BLOCK_MAX;
+  storeOpenBlocks(rs, b, count);
+  int i;
+  for (i = 0; i < count; i++)
+    rs->blocks[b + i]->n = (i < count - 1) ? ROW_BLOCK_MAX : n - i * ROW_BLOCK_MAX;
+  fenBuild(rs);
+}
+
+void edStoreDelete(int at) {
+  // drops the slot for row at. freeing the row's contents is up to the caller
+  edRowStore *rs = &E.rows;
+  int off;
+  int b = storeLocate(rs, at, &off);
+  storeOwn(rs, b);
+  storeMaterialize(rs, b);
+  edRowBlock *blk = rs->blocks[b];
+
+  memmove(&blk->rows[off], &blk->rows[off + 1], sizeof(edRow) * (blk->n - off - 1));
+  blk->n--;
+  fenAdd(rs, b, -1);
+
+  // keep blocks reasonably full so the block list stays short.
+  // lazy neighbours are left alone rather than built just to merge them
+  if (blk->n == 0) {
+    storeRemoveBlock(rs, b);
+  } else if (b + 1 < rs->nBlocks && rs->blocks[b + 1]->rows &&
+             blk->n + rs->blocks[b + 1]->n <= ROW_BLOCK_MAX / 2) {
+    storeMerge(rs, b);
+  } else if (b > 0 && rs->blocks[b - 1]->rows &&
+             blk->n + rs->blocks[b - 1]->n <= ROW_BLOCK_MAX / 2) {
+    storeMerge(rs, b - 1);
+  }
+}
+
+void edStoreMarkSaved() {
+  // the rows have just been saved, so each is now the line on disk it's at
+  edRowStore *rs = &E.rows;
+  int start = 0;
+  int b;
+  for (b = 0; b < rs->nBlocks; b++) {
+    edRowBlock *blk = rs->blocks[b];
+    blk->disk = start;
+    if (blk->rows) {
+      int i;
+      for (i = 0; i < blk->n; i++) blk->rows[i].disk = start + i;
+    }
+    start += blk->n;
+  }
+}
+
+void edStoreSnap(edRowSnap *snap) {
+  // only the list of blocks is copied; see storeOwn for the rest
+  edRowStore *rs = &E.rows;
+  snap->nBlocks = rs->nBlocks;
+  snap->blocks = malloc(sizeof(edRowBlock *) * (rs->nBlocks + 1));
+  memcpy(snap->blocks, rs->blocks, sizeof(edRowBlock *) * rs->nBlocks);
+
+  int b;
+  for (b = 0; b < rs->nBlocks; b++) rs->blocks[b]->refs++;
+}
+
+void edStoreSnapFree(edRowSnap *snap) {
+  // blocks the store has since copied belong to the snapshot alone, and go
+  // with it. needs the lock, as the rows go back to the row allocator
+  int b;
+  for (b = 0; b < snap->nBlocks; b++) {
+    edRowBlock *blk = snap->blocks[b];
+    if (--blk->refs > 0) continue;
+
+    if (blk->rows) {
+      int i;
+      for (i = 0; i < blk->n; i++) edFreeRow(&blk->rows[i]);
+      free(blk->rows);
+    }
+    free(blk);
+  }
+  free(snap->blocks);
+  snap->blocks = NULL;
+  snap->nBlocks = 0;
+}
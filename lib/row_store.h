@@ -0,0 +1,69 @@
+#ifndef ROW_STORE_H_
+#define ROW_STORE_H_
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "row.h"
+
+// max rows per block. inserts/deletes only ever shift rows inside one block.
+#define ROW_BLOCK_MAX 512
+
+// a block whose rows is NULL is still lazy: its n rows are lines
+// [line, line + n) of the mapped file, and get built on first access.
+typedef struct edRowBlock {
+  int n;
+  int line;
+  edRow *rows;
+  int hlOpen; // lazy blocks: does a ml comment run past the last row?
+  int refs; // the store, plus snapshots still sharing it
+  int disk; // lazy blocks: the line on disk of the first row, see edRow.disk
+} edRowBlock;
+
+// a file opened with mmap, plus the start offset of each of its lines.
+// lineOff[nLines] is one past the newline that would end the last line.
+typedef struct edFileMap {
+  char *b;
+  size_t len;
+  size_t *lineOff;
+  int nLines;
+  int hasCR; // any '\r' to strip from line endings?
+} edFileMap;
+
+// the document is a list of row blocks. a fenwick tree over the block sizes
+// finds the block holding a given row in O(log n).
+typedef struct edRowStore {
+  edRowBlock **blocks;
+  int nBlocks;
+  int cap;
+  int *sizes; // fenwick tree, 1-based
+  int hint; // block of the last lookup, -1 if none
+  int hintStart; // index of the first row in the hinted block
+} edRowStore;
+
+// the blocks of the store as they were when it was taken. they're shared with
+// the store until it changes one, which it copies first, so a snapshot stays
+// as it is without holding the lock
+typedef struct edRowSnap {
+  edRowBlock **blocks;
+  int nBlocks;
+} edRowSnap;
+
+void edStoreInit(edRowStore *rs);
+void edStoreFree(edRowStore *rs);
+edRow *edRowAt(int at);
+edRow *edRowRead(int at);
+edRow *edRowPeek(int at);
+char *edRowChars(int at, int *len);
+char *edBlockChars(edRowBlock *blk, int off, int *len);
+edRowBlock *edRowBlockOf(int at, int *start);
+int edRowIndex(edRow *row);
+void edStoreLoadLazy(int nLines);
+edRow *edStoreInsert(int at);
+void edStoreInsertRows(int at, int n);
+void edStoreDelete(int at);
+void edStoreMarkSaved();
+void edStoreSnap(edRowSnap *snap);
+void edStoreSnapFree(edRowSnap *snap);
+
+#endif // ROW_STORE_H_
@@ -0,0 +1,173 @@
+#include "screen.h"
+#include "editor_configs.h"
+#include "syntax_highlighting.h"
+
+// escape sequence selecting the foreground color of each highlight class
+static struct {
+  char s[8];
+  int len;
+} sgr[HL_CLASSES];
+
+static void sgrInit() {
+  int i;
+  for (i = 0; i < HL_CLASSES; i++) {
+    int color = (i == HL_NORMAL) ? 39 : edSyntaxToColor(i);
+    sgr[i].len = snprintf(sgr[i].s, sizeof(sgr[i].s), "\x1b[%dm", color);
+  }
+}
+
+static int cellSame(edScreen *s, int i) {
+  return s->back[i] == s->front[i] && s->backHl[i] == s->frontHl[i];
+}
+
+static int cellBlank(edScreen *s, int i) {
+  return s->back[i] == ' ' && s->backHl[i] == HL_NORMAL;
+}
+
+void edScreenResize(int rows, int cols) {
+  edScreen *s = &E.screen;
+  if (s->front && rows == s->rows && cols == s->cols) return;
+  if (!s->front) sgrInit();
+
+  s->rows = rows;
+  s->cols = cols;
+  s->front = realloc(s->front, rows * cols);
+  s->frontHl = realloc(s->frontHl, rows * cols);
+  s->back = realloc(s->back, rows * cols);
+  s->backHl = realloc(s->backHl, rows * cols);
+  edScreenInvalidate();
+}
+
+void edScreenInvalidate() {
+  // the terminal's contents are unknown, so the next flush repaints everything
+  E.screen.valid = 0;
+}
+
+void edScreenClear() {
+  memset(E.screen.back, ' ', E.screen.rows * E.screen.cols);
+  memset(E.screen.backHl, HL_NORMAL, E.screen.rows * E.screen.cols);
+}
+
+void edScreenPut(int y, int x, char c, unsigned char hl) {
+  edScreen *s = &E.screen;
+  if (y < 0 || y >= s->rows || x < 0 || x >= s->cols) return;
+  s->back[y * s->cols + x] = c;
+  s->backHl[y * s->cols + x] = hl;
+}
+
+void edScreenPuts(int y, int x, const char *str, int len, unsigned char hl) {
+  // a run of cells sharing one class
+  edScreen *s = &E.screen;
+  if (y < 0 || y >= s->rows || x < 0 || x >= s->cols) return;
+  if (len > s->cols - x) len = s->cols - x;
+  if (len <= 0) return;
+
+  memcpy(&s->back[y * s->cols + x], str, len);
+  memset(&s->backHl[y * s->cols + x], hl, len);
+}
+
+static void screenMove(str *db, int y, int x) {
+  edScreen *s = &E.screen;
+  if (s->cY == y && s->cX == x) return;
+
+  char buf[32];
+  int len;
+  if (x == 0 && s->cY == y - 1 && s->cY >= 0) {
+    len = snprintf(buf, sizeof(buf), "\r\n");
+  } else if (s->cY == y && s->cX >= 0 && x > s->cX) {
+    len = snprintf(buf, sizeof(buf), "\x1b[%dC", x - s->cX);
+  } else {
+    len = snprintf(buf, sizeof(buf), "\x1b[%d;%dH", y + 1, x + 1);
+  }
+  dbAppend(db, buf, len);
+  s->cY = y;
+  s->cX = x;
+}
+
+static void screenAttr(str *db, unsigned char hl) {
+  edScreen *s = &E.screen;
+  if (s->hl == hl) return;
+
+  if ((s->hl ^ hl) & HL_INVERSE) {
+    if (hl & HL_INVERSE) dbAppend(db, "\x1b[7m", 4);
+    else dbAppend(db, "\x1b[27m", 5);
+  }
+
+  int cls = hl & ~HL_INVERSE;
+  if (cls != (s->hl & ~HL_INVERSE)) dbAppend(db, sgr[cls].s, sgr[cls].len);
+  s->hl = hl;
+}
+
+static void screenSpan(str *db, int from, int to) {
+  // writes cells [from, to] of the back buffer, one run per highlight class
+  edScreen *s = &E.screen;
+  while (from <= to) {
+    int run = from + 1;
+    while (run <= to && s->backHl[run] == s->backHl[from]) run++;
+
+    screenAttr(db, s->backHl[from]);
+    dbAppend(db, &s->back[from], run - from);
+    from = run;
+  }
+}
+
+void edScreenFlush(str *db, int cY, int cX) {
+  // appends what it takes to turn front into back, then leaves the cursor at cY, cX
+  edScreen *s = &E.screen;
+  int size = s->rows * s->cols;
+
+  if (!s->valid) {
+    dbAppend(db, "\x1b[m\x1b[H\x1b[2J", 10);
+    memset(s->front, ' ', size);
+    memset(s->frontHl, HL_NORMAL, size);
+    s->valid = 1;
+    s->cY = s->cX = 0;
+    s->hl = HL_NORMAL;
+  }
+
+  int y;
+  for (y = 0; y < s->rows; y++) {
+    int row = y * s->cols;
+    if (!memcmp(&s->back[row], &s->front[row], s->cols) &&
+        !memcmp(&s->backHl[row], &s->frontHl[row], s->cols))
+      continue;
+
+    // anything past last is blank, and can be cleared with one \x1b[K
+    int last = s->cols - 1;
+    while (last >= 0 && cellBlank(s, row + last)) last--;
+
+    int x = 0;
+    while (x < s->cols) {
+      if (cellSame(s, row + x)) {
+        x++;
+        continue;
+      }
+
+      if (x > last) {
+        screenMove(db, y, x);
+        screenAttr(db, HL_NORMAL);
+        dbAppend(db, "\x1b[K", 3);
+        break;
+      }
+
+      // extend the span over any short runs of unchanged cells
+      int end = x, j;
+      for (j = x + 1; j <= last && j - end <= SPAN_GAP; j++) {
+        if (!cellSame(s, row + j)) end = j;
+      }
+
+      screenMove(db, y, x);
+      screenSpan(db, row + x, row + end);
+
+      // writing the last column leaves the cursor in limbo until the next char
+      s->cX = (end + 1 < s->cols) ? end + 1 : -1;
+      if (s->cX == -1) s->cY = -1;
+      x = end + 1;
+    }
+  }
+
+  memcpy(s->front, s->back, size);
+  memcpy(s->frontHl, s->backHl, size);
+  screenAttr(db, HL_NORMAL);
+  screenMove(db, cY, cX);
+}
@@ -0,0 +1,44 @@
+#ifndef SCREEN_H_
+#define SCREEN_H_
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "constants.h"
+#include "dynamic_str.h"
+
+// cells wider than this many unchanged cells apart are sent as separate spans
+#define SPAN_GAP 4
+
+// the terminal as a grid of cells, each a character plus the highlight class
+// it's drawn in (optionally or'd with HL_INVERSE). characters and classes are
+// kept in separate arrays so runs of cells can be copied/compared in bulk.
+// frames are drawn into back, and only the cells that differ from front
+// (what the terminal shows) get written out.
+typedef struct edScreen {
+  int rows, cols;
+  char *front;
+  unsigned char *frontHl;
+  char *back;
+  unsigned char *backHl;
+  int valid; // does front match the terminal?
+  int cY, cX; // where the terminal cursor is, -1 if unknown
+  unsigned char hl; // the terminal's current attributes
+} edScreen;
+
+// what drawing frames has come to so far
+typedef struct edFrameStats {
+  long rendered; // frames drawn
+  long skipped;  // keys taken without a frame of their own after them
+  long bytes;    // written to the terminal by the frames
+} edFrameStats;
+
+void edScreenResize(int rows, int cols);
+void edScreenInvalidate();
+void edScreenClear();
+void edScreenPut(int y, int x, char c, unsigned char hl);
+void edScreenPuts(int y, int x, const char *s, int len, unsigned char hl);
+void edScreenFlush(str *db, int cY, int cX);
+
+#endif // SCREEN_H_
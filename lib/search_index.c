@@ -0,0 +1,427 @@
+#include "search_index.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// the matches of the query typed so far and of each of its prefixes
+static edMatchList cache[SEARCH_CACHE_DEPTH];
+// the matches of the last pattern, and the dfa to step through them with
+static edMatchList reList;
+static edDFA *reDFA;
+
+// matches found by one task of a search
+typedef struct findTask {
+  edMatch *m;
+  int n, cap;
+  int full;
+} findTask;
+
+typedef struct findJob {
+  const char *q;
+  int qLen;
+  edRegex *re;
+  int *starts; // first row of each block
+  findTask *tasks;
+
+  // dfas of tasks that are done, for the next ones to pick up where they
+  // left off. at most one per thread is ever in use
+  pthread_mutex_t lock;
+  edDFA *idle[POOL_MAX_THREADS + 1];
+  int nIdle;
+} findJob;
+
+// a regex match in row, for findTask t
+typedef struct findHit {
+  findTask *t;
+  int row;
+} findHit;
+
+static const char *findIn(const char *s, size_t len, const char *q, size_t m) {
+  // the first q (of m >= 1 bytes) in s. with SSE2, 16 spots at a time are
+  // checked for q's first and last byte, and only those get compared
+  if (m > len) return NULL;
+  if (m == 1) return memchr(s, q[0], len);
+
+  size_t i = 0;
+#if defined(__SSE2__)
+  const __m128i first = _mm_set1_epi8(q[0]);
+  const __m128i last = _mm_set1_epi8(q[m - 1]);
+
+  for (; i + m - 1 + 16 <= len; i += 16) {
+    __m128i a = _mm_loadu_si128((const __m128i *)&s[i]);
+    __m128i b = _mm_loadu_si128((const __m128i *)&s[i + m - 1]);
+    unsigned int mask = _mm_movemask_epi8(
+      _mm_and_si128(_mm_cmpeq_epi8(a, first), _mm_cmpeq_epi8(b, last)));
+
+    while (mask) {
+      int k = __builtin_ctz(mask);
+      if (!memcmp(&s[i + k + 1], q + 1, m - 2)) return &s[i + k];
+      mask &= mask - 1;
+    }
+  }
+#endif
+
+  // whatever's left (or everything, without SSE2)
+  for (; i + m <= len; i++) {
+    if (s[i] == q[0] && s[i + m - 1] == q[m - 1] && !memcmp(&s[i + 1], q + 1, m - 2))
+      return &s[i];
+  }
+  return NULL;
+}
+
+static void findPush(findTask *t, int row, int col, int len) {
+  if (t->n == SEARCH_MAX_MATCHES) {
+    t->full = 1;
+    return;
+  }
+  if (t->n == t->cap) {
+    t->cap = t->cap ? t->cap * 2 : 256;
+    t->m = realloc(t->m, sizeof(edMatch) * t->cap);
+  }
+  t->m[t->n].row = row;
+  t->m[t->n].col = col;
+  t->m[t->n].len = len;
+  t->n++;
+}
+
+static void findRegexHit(void *arg, int start, int end) {
+  findHit *h = arg;
+  findPush(h->t, h->row, start, end - start);
+}
+
+static edDFA *findTakeDFA(findJob *job) {
+  pthread_mutex_lock(&job->lock);
+  edDFA *d = job->nIdle ? job->idle[--job->nIdle] : edDFANew(job->re);
+  pthread_mutex_unlock(&job->lock);
+  return d;
+}
+
+static void findGiveDFA(findJob *job, edDFA *d) {
+  pthread_mutex_lock(&job->lock);
+  job->idle[job->nIdle++] = d;
+  pthread_mutex_unlock(&job->lock);
+}
+
+static void findRegexBlock(findTask *t, edDFA *d, edRowBlock *blk, int row) {
+  // a pattern is run over one row at a time, since it may hold ^ or $
+  findHit h = {t, 0};
+  int j;
+  for (j = 0; j < blk->n && !t->full; j++) {
+    int len;
+    char *s = edBlockChars(blk, j, &len);
+    h.row = row + j;
+    edRegexEach(d, s, len, findRegexHit, &h);
+  }
+}
+static void findBlocks(void *arg, int i) {
+  // every match in one run of blocks. only reads the store, so these run
+  // side by side on the pool
+  findJob *job = arg;
+  findTask *t = &job->tasks[i];
+  edRowStore *rs = &E.rows;
+
+  int b = i * SEARCH_TASK_BLOCKS;
+  int stop = (b + SEARCH_TASK_BLOCKS < rs->nBlocks) ? b + SEARCH_TASK_BLOCKS : rs->nBlocks;
+  if (job->re) {
+    edDFA *d = findTakeDFA(job);
+    for (; b < stop && !t->full; b++)
+      findRegexBlock(t, d, rs->blocks[b], job->starts[b]);
+    findGiveDFA(job, d);
+    return;
+  }
+
+  for (; b < stop && !t->full; b++) {
+    edRowBlock *blk = rs->blocks[b];
+    int row = job->starts[b];
+    const char *p;
+
+    if (blk->rows) {
+      int j;
+      for (j = 0; j < blk->n; j++) {
+        const char *s = blk->rows[j].chars;
+        int len = blk->rows[j].size;
+        for (p = s; (p = findIn(p, len - (p - s), job->q, job->qLen)); p++)
+          findPush(t, row + j, p - s, job->qLen);
+      }
+      continue;
+    }
+
+    // a lazy block is one stretch of the mapped file, so it's searched in one
+    // go. queries never hold a line ending, so no match spans two lines
+    size_t *off = &E.map.lineOff[blk->line];
+    const char *s = &E.map.b[off[0]];
+    size_t len = off[blk->n] - 1 - off[0];
+    int j = 0;
+    for (p = s; (p = findIn(p, len - (p - s), job->q, job->qLen)); p++) {
+      size_t at = p - E.map.b;
+      while (off[j + 1] <= at) j++;
+      findPush(t, row + j, at - off[j], job->qLen);
+    }
+  }
+}
+
+static void findAll(edMatchList *ml, const char *q, int qLen) {
+  // split the blocks across the thread pool, then join up what each found
+  edRowStore *rs = &E.rows;
+  findJob job;
+  job.q = q;
+  job.qLen = qLen;
+  job.re = ml->re;
+  pthread_mutex_init(&job.lock, NULL);
+  job.nIdle = 0;
+  job.starts = malloc(sizeof(int) * (rs->nBlocks + 1));
+
+  int b;
+  int row = 0;
+  for (b = 0; b < rs->nBlocks; b++) {
+    job.starts[b] = row;
+    row += rs->blocks[b]->n;
+  }
+
+  int nTasks = (rs->nBlocks + SEARCH_TASK_BLOCKS - 1) / SEARCH_TASK_BLOCKS;
+  job.tasks = calloc(nTasks > 0 ? nTasks : 1, sizeof(findTask));
+  edPoolRun(findBlocks, &job, nTasks);
+
+  long total = 0;
+  int i;
+  ml->full = 0;
+  for (i = 0; i < nTasks; i++) {
+    total += job.tasks[i].n;
+    if (job.tasks[i].full) ml->full = 1;
+  }
+  if (total > SEARCH_MAX_MATCHES) ml->full = 1;
+
+  ml->n = 0;
+  if (!ml->full && total > ml->cap) {
+    ml->cap = total;
+    ml->m = realloc(ml->m, sizeof(edMatch) * ml->cap);
+  }
+  for (i = 0; i < nTasks; i++) {
+    if (!ml->full) {
+      memcpy(&ml->m[ml->n], job.tasks[i].m, sizeof(edMatch) * job.tasks[i].n);
+      ml->n += job.tasks[i].n;
+    }
+    free(job.tasks[i].m);
+  }
+
+  for (i = 0; i < job.nIdle; i++) edDFAFree(job.idle[i]);
+  pthread_mutex_destroy(&job.lock);
+  free(job.tasks);
+  free(job.starts);
+}
+
+static void findNarrow(edMatchList *ml, edMatchList *from, const char *q, int qLen) {
+  // q starts with from's query, so it can only match where that did.
+  // ml and from may be the same list
+  edRowStore *rs = &E.rows;
+  if (from->n > ml->cap) {
+    ml->cap = from->n;
+    ml->m = realloc(ml->m, sizeof(edMatch) * ml->cap);
+  }
+
+  int b = 0;
+  int start = 0;
+  int n = 0;
+  int i;
+  for (i = 0; i < from->n; i++) {
+    edMatch m = from->m[i];
+    while (m.row >= start + rs->blocks[b]->n) start += rs->blocks[b++]->n;
+
+    int len;
+    char *s = edBlockChars(rs->blocks[b], m.row - start, &len);
+    if (m.col + qLen <= len && !memcmp(&s[m.col], q, qLen)) {
+      m.len = qLen;
+      ml->m[n++] = m;
+    }
+  }
+  ml->n = n;
+  ml->full = 0;
+}
+
+edMatchList *edFindMatches(const char *q) {
+  // every match of q, from the cache if it was searched for already, or by
+  // re-checking the matches of the longest prefix of it that was
+  int qLen = strlen(q);
+  if (qLen == 0) return NULL;
+
+  int slot = (qLen < SEARCH_CACHE_DEPTH ? qLen : SEARCH_CACHE_DEPTH) - 1;
+  edMatchList *ml = &cache[slot];
+  edMatchList *from = NULL;
+
+  int i;
+  for (i = slot; i >= 0; i--) {
+    edMatchList *c = &cache[i];
+    if (c->q && c->version == E.version && c->qLen <= qLen &&
+        !memcmp(c->q, q, c->qLen)) {
+      if (c->qLen == qLen) return c;
+      if (!c->full) from = c;
+      break;
+    }
+  }
+
+  if (from) findNarrow(ml, from, q, qLen);
+  else findAll(ml, q, qLen);
+
+  free(ml->q);
+  ml->q = strdup(q);
+  ml->qLen = qLen;
+  ml->version = E.version;
+  return ml;
+}
+
+edMatchList *edFindRegex(const char *pat, const char **err) {
+  // every match of the pattern. unlike text, a longer pattern can match
+  // where a shorter one didn't, so only the last one is kept
+  if (*pat == '\0') return NULL;
+  if (reList.q && reList.version == E.version && !strcmp(reList.q, pat)) return &reList;
+
+  edRegex *re = edRegexCompile(pat, err);
+  if (re == NULL) return NULL;
+  edDFAFree(reDFA);
+  edRegexFree(reList.re);
+  reList.re = re;
+  reDFA = edDFANew(re);
+
+  findAll(&reList, pat, strlen(pat));
+  free(reList.q);
+  reList.q = strdup(pat);
+  reList.qLen = strlen(pat);
+  reList.version = E.version;
+  return &reList;
+}
+
+static int matchBefore(edMatch *m, int row, int col) {
+  return m->row < row || (m->row == row && m->col < col);
+}
+
+static int matchFirst(edMatchList *ml, int row, int col) {
+  // index of the first match at or past row/col
+  int lo = 0;
+  int hi = ml->n;
+  while (lo < hi) {
+    int mid = lo + (hi - lo) / 2;
+    if (matchBefore(&ml->m[mid], row, col)) lo = mid + 1;
+    else hi = mid;
+  }
+  return lo;
+}
+
+// the match of a row matchScan is after, of those starting in [from, to)
+typedef struct scanHit {
+  int from, to, dir;
+  int found;
+  edMatch m;
+} scanHit;
+
+static void scanRegexHit(void *arg, int start, int end) {
+  scanHit *h = arg;
+  if (start < h->from || start >= h->to || (h->found && h->dir == 1)) return;
+  h->found = 1;
+  h->m.col = start;
+  h->m.len = end - start;
+}
+
+static int scanRow(edMatchList *ml, const char *s, int len, scanHit *h) {
+  if (ml->re) {
+    edRegexEach(reDFA, s, len, scanRegexHit, h);
+    return h->found;
+  }
+
+  const char *p;
+  for (p = s + h->from; p < s + h->to && (p = findIn(p, len - (p - s), ml->q, ml->qLen)); p++) {
+    if (p >= s + h->to) break;
+    h->found = 1;
+    h->m.col = p - s;
+    h->m.len = ml->qLen;
+    if (h->dir == 1) break;
+  }
+  return h->found;
+}
+
+static int matchScan(edMatchList *ml, int row, int col, int dir, edMatch *out) {
+  // too many matches to keep around: look through the rows from row/col on.
+  // with that many, one is never far
+  int i;
+  for (i = 0; i <= E.nRows; i++, row += dir) {
+    if (row < 0) row = E.nRows - 1;
+    else if (row >= E.nRows) row = 0;
+
+    int len;
+    const char *s = edRowChars(row, &len);
+    scanHit h;
+    h.from = (i == 0 && dir == 1) ? col + 1 : 0;
+    h.to = (i == 0 && dir == -1) ? col : len;
+    h.dir = dir;
+    h.found = 0;
+    if (scanRow(ml, s, len, &h)) {
+      *out = h.m;
+      out->row = row;
+      return 1;
+    }
+  }
+  return 0;
+}
+
+int edNextMatch(edMatchList *ml, int row, int col, int dir, edMatch *out) {
+  // the match after row/col (before, if dir is -1), wrapping around the ends
+  if (ml->full) return matchScan(ml, row, col, dir, out);
+  if (ml->n == 0) return 0;
+
+  int i;
+  if (dir == 1) {
+    i = matchFirst(ml, row, col + 1);
+    if (i == ml->n) i = 0;
+  } else {
+    i = matchFirst(ml, row, col) - 1;
+    if (i < 0) i = ml->n - 1;
+  }
+  *out = ml->m[i];
+  return 1;
+}
+
+// the matches edRowMatches is gathering
+typedef struct rowHits {
+  edMatch *out;
+  int n, max;
+  int row;
+} rowHits;
+
+static void rowRegexHit(void *arg, int start, int end) {
+  rowHits *h = arg;
+  if (h->n == h->max) return;
+  h->out[h->n].row = h->row;
+  h->out[h->n].col = start;
+  h->out[h->n].len = end - start;
+  h->n++;
+}
+
+int edRowMatches(edMatchList *ml, int row, edMatch *out, int max) {
+  // the first max matches in a row, in order, for drawing
+  if (ml->version != E.version) return 0;
+
+  int n = 0;
+  if (!ml->full) {
+    int i;
+    for (i = matchFirst(ml, row, 0); i < ml->n && ml->m[i].row == row && n < max; i++)
+      out[n++] = ml->m[i];
+    return n;
+  }
+
+  int len;
+  const char *s = edRowChars(row, &len);
+  if (ml->re) {
+    rowHits h = {out, 0, max, row};
+    edRegexEach(reDFA, s, len, rowRegexHit, &h);
+    return h.n;
+  }
+
+  const char *p;
+  for (p = s; n < max && (p = findIn(p, len - (p - s), ml->q, ml->qLen)); p++) {
+    out[n].row = row;
+    out[n].col = p - s;
+    out[n].len = ml->qLen;
+    n++;
+  }
+  return n;
+}
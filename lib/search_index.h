@@ -0,0 +1,50 @@
+#ifndef SEARCH_INDEX_H_
+#define SEARCH_INDEX_H_
+
+#ifndef _DEFAULT_SOURCE
+#define _DEFAULT_SOURCE
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "editor_configs.h"
+#include "regex_dfa.h"
+#include "row_store.h"
+#include "thread_pool.h"
+
+// more matches than this aren't kept; stepping through them scans instead
+#define SEARCH_MAX_MATCHES (1 << 20)
+// queries up to this long each keep their matches, for narrowing/backspace
+#define SEARCH_CACHE_DEPTH 32
+// row blocks searched by one task of the thread pool
+#define SEARCH_TASK_BLOCKS 32
+// most matches drawn in one row
+#define SEARCH_ROW_MATCHES 256
+
+// where a query matched: a row, the index into its chars, and how many chars
+typedef struct edMatch {
+  int row;
+  int col;
+  int len;
+} edMatch;
+
+// every match of q in the document, in order. full means there were more
+// than SEARCH_MAX_MATCHES, and m holds none of them. re is set if q is a
+// pattern rather than text
+typedef struct edMatchList {
+  char *q;
+  int qLen;
+  edRegex *re;
+  edMatch *m;
+  int n, cap;
+  int full;
+  unsigned int version; // E.version the matches were found at
+} edMatchList;
+
+edMatchList *edFindMatches(const char *q);
+edMatchList *edFindRegex(const char *pat, const char **err);
+int edNextMatch(edMatchList *ml, int row, int col, int dir, edMatch *out);
+int edRowMatches(edMatchList *ml, int row, edMatch *out, int max);
+
+#endif // SEARCH_INDEX_H_
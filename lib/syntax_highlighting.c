@@ -23,7 +23,8 @@ struct edSyntax HLDB[] = {
     cExts,
     "//", "/*", "*/",
     cKeywords,
-    HL_NUMBERS | HL_STRINGS
+    HL_NUMBERS | HL_STRINGS,
+    NULL, NULL
   },
 
   {
@@ -31,7 +32,8 @@ struct edSyntax HLDB[] = {
     pyExts,
     "#", "\"\"\"", "\"\"\"",
     pyKeywords,
-    HL_NUMBERS | HL_STRINGS
+    HL_NUMBERS | HL_STRINGS,
+    NULL, NULL
   }
 
 };
@@ -55,18 +57,97 @@ int edSyntaxToColor(int hl) {
   }
 }
 
-void edUpdateHL(edRow *row) {
-  row->hl = realloc(row->hl, row->rSize);
-  memset(row->hl, HL_NORMAL, row->rSize);
+static unsigned int hlHash(unsigned int h, unsigned char c) {
+  // FNV-1a, a byte at a time
+  return (h ^ c) * 16777619u;
+}
+
+static edKeywordTable *hlCompileKeywords(char **keywords) {
+  int n = 0;
+  while (keywords[n]) n++;
+
+  // at most half full, so probe chains stay short
+  edKeywordTable *kt = malloc(sizeof(edKeywordTable));
+  unsigned int size = 16;
+  while (size < (unsigned int)n * 2) size *= 2;
+  kt->slots = calloc(size, sizeof(edKeyword));
+  kt->mask = size - 1;
+  kt->maxLen = 0;
+
+  int j;
+  for (j = 0; j < n; j++) {
+    int kLen = strlen(keywords[j]);
+    int kw2 = keywords[j][kLen - 1] == '|';
+    if (kw2) kLen--;
+
+    unsigned int h = 2166136261u;
+    int k;
+    for (k = 0; k < kLen; k++) h = hlHash(h, keywords[j][k]);
+    while (kt->slots[h & kt->mask].s) h++;
+
+    edKeyword *kw = &kt->slots[h & kt->mask];
+    kw->s = keywords[j];
+    kw->len = kLen;
+    kw->hl = kw2 ? HL_KEYWORD2 : HL_KEYWORD1;
+    if (kLen > kt->maxLen) kt->maxLen = kLen;
+  }
+  return kt;
+}
+
+static unsigned char *hlCompileClasses(struct edSyntax *syn) {
+  // one lookup per byte in the lexer instead of isSep/isdigit/strncmp calls
+  unsigned char *cc = calloc(256, 1);
+  int c;
+  for (c = 0; c < 256; c++) {
+    if (isSep(c)) cc[c] |= CC_SEP;
+    if (isdigit(c) && (syn->flags & HL_NUMBERS)) cc[c] |= CC_DIGIT;
+    if ((c == '"' || c == '\'') && (syn->flags & HL_STRINGS)) cc[c] |= CC_QUOTE;
+  }
+
+  if (syn->commentStartToken && syn->commentStartToken[0])
+    cc[(unsigned char)syn->commentStartToken[0]] |= CC_COMMENT;
+  if (syn->mcommentStartToken && syn->mcommentStartToken[0] &&
+      syn->mcommentEndToken && syn->mcommentEndToken[0]) {
+    cc[(unsigned char)syn->mcommentStartToken[0]] |= CC_MCOMMENT;
+    cc[(unsigned char)syn->mcommentEndToken[0]] |= CC_MCOMMENT_END;
+  }
+  return cc;
+}
+
+static edKeyword *hlKeyword(edKeywordTable *kt, const unsigned char *cc,
+                            const char *s, int len) {
+  // the keyword the word at s is, if any. the word is hashed in the same pass
+  // that finds where it ends, and given up on once it's longer than any keyword
+  unsigned int h = 2166136261u;
+  int n;
+  for (n = 0; n < len && !(cc[(unsigned char)s[n]] & CC_SEP); n++) {
+    if (n == kt->maxLen) return NULL;
+    h = hlHash(h, s[n]);
+  }
+
+  for (; kt->slots[h & kt->mask].s; h++) {
+    edKeyword *kw = &kt->slots[h & kt->mask];
+    if (kw->len == n && !memcmp(kw->s, s, n)) return kw;
+  }
+  return NULL;
+}
+
+static int hlLex(struct edSyntax *syn, const char *s, int len, int inComment,
+                 unsigned char *hl) {
+  // highlights the len chars of s into hl, starting inside a ml comment or not,
+  // and returns whether one is still open at the end. s needn't end in a '\0'.
+  // only touches its arguments, so the worker can run it without the lock
+  memset(hl, HL_NORMAL, len);
 
-  if (E.syntax == NULL) return;
+  if (syn == NULL) return 0;
 
-  char **keywords = E.syntax->keywords;
+  edKeywordTable *kt = syn->kwTable;
+  const unsigned char *cc = syn->charClass;
 
   // comment tokens
-  char *cst = E.syntax->commentStartToken;
-  char *mcst = E.syntax->mcommentStartToken;
-  char *mcet = E.syntax->mcommentEndToken;
+  char *cst = syn->commentStartToken;
+  char *mcst = syn->mcommentStartToken;
+  char *mcet = syn->mcommentEndToken;
 
   // comment token lens
   int cstLen = cst ? strlen(cst) : 0;
@@ -75,122 +156,457 @@ void edUpdateHL(edRow *row) {
 
   int prevSep = 1;
   int inStr = 0;
-  int inComment = (row->rowInd > 0 && E.row[row->rowInd - 1].hlOpenComment);
 
   int i = 0;
-  while (i < row->rSize) {
-    char c = row->render[i];
-    unsigned char prevHL = (i > 0) ? row->hl[i - 1] : HL_NORMAL;
+  while (i < len) {
+    char c = s[i];
+    int k = cc[(unsigned char)c];
+    unsigned char prevHL = (i > 0) ? hl[i - 1] : HL_NORMAL;
 
-    // hl single-line comments
-    if (cstLen && !inStr && !inComment) {
-      if (!strncmp(&row->render[i], cst, cstLen)) {
-        memset(&row->hl[i], HL_COMMENT, row->rSize - i);
-        break;
+    // comment tokens are only compared where their first byte is
+    if (inComment) {
+      // if we're in a multiline comment, then we can safely highlight
+      hl[i] = HL_MCOMMENT;
+      if ((k & CC_MCOMMENT_END) && len - i >= mcetLen &&
+          !strncmp(&s[i], mcet, mcetLen)) {
+        memset(&hl[i], HL_MCOMMENT, mcetLen);
+        i += mcetLen;
+        inComment = 0;
+        prevSep = 1;
+      } else {
+        i++;
       }
+      continue;
     }
 
-    // hl multi-line comments
-    if (mcstLen && mcetLen && !inStr) {
-      if (inComment) {
-        // if we're in a multiline comment, then we can safely highlight
-        row->hl[i] = HL_MCOMMENT;
-        if (!strncmp(&row->render[i], mcet, mcetLen)) {
-          memset(&row->hl[i], HL_MCOMMENT, mcetLen);
-          i += mcetLen;
-          inComment = 0;
-          prevSep = 1;
-          continue;
-        } else {
-          i++;
-          continue;
-        }
-      } else if (!strncmp(&row->render[i], mcst, mcstLen)) {
-        // check if the current token is the start of a multiline comment
-        memset(&row->hl[i], HL_MCOMMENT, mcstLen);
-        i += mcstLen;
-        inComment = 1;
+    if (inStr) {
+      hl[i] = HL_STRING;
+      if (c == '\\' && i + 1 < len) {
+        // handling escaped quotes
+        hl[i + 1] = HL_STRING;
+        i += 2;
         continue;
       }
+      if (c == inStr) inStr = 0; // once we see another "/', we exit string mode
+      i++;
+      prevSep = 1;
+      continue;
     }
 
-    // hl strings
-    if (E.syntax->flags & HL_STRINGS) {
-      if (inStr) {
-        row->hl[i] = HL_STRING;
-        if (c == '\\' && i + 1 < row->rSize) {
-          // handling escaped quotes
-          row->hl[i + 1] = HL_STRING;
-          i += 2;
-          continue;
-        }
-        if (c == inStr) inStr = 0; // once we see another "/', we exit string mode
-        i++;
-        prevSep = 1;
-        continue;
-      } else {
-        // if we see a " or ', we assume we're in a string.
-        if (c == '"' || c == '\'') {
-          inStr = c;
-          row->hl[i] = HL_STRING;
-          i++;
-          continue;
-        }
-      }
+    // hl single-line comments
+    if ((k & CC_COMMENT) && len - i >= cstLen && !strncmp(&s[i], cst, cstLen)) {
+      memset(&hl[i], HL_COMMENT, len - i);
+      break;
     }
 
-    // make sure we need to highlight numbers for this file
-    if (E.syntax->flags & HL_NUMBERS) {
-      // prev. char must be num. or sep. for curr. num. to be highlighted
-      // second case handles decimals
-      if((isdigit(c) && (prevSep || prevHL == HL_NUMBER)) ||
-         (c == '.' && prevHL == HL_NUMBER)) {
-        row->hl[i] = HL_NUMBER;
+    // check if the current token is the start of a multiline comment
+    if ((k & CC_MCOMMENT) && len - i >= mcstLen && !strncmp(&s[i], mcst, mcstLen)) {
+      memset(&hl[i], HL_MCOMMENT, mcstLen);
+      i += mcstLen;
+      inComment = 1;
+      continue;
+    }
 
-        // we're in the middle of highlighting a sequence, so we increment/continue
-        i++;
-        prevSep = 0;
-        continue;
-      }
+    // if we see a " or ', we assume we're in a string.
+    if (k & CC_QUOTE) {
+      inStr = c;
+      hl[i] = HL_STRING;
+      i++;
+      continue;
+    }
+
+    // prev. char must be num. or sep. for curr. num. to be highlighted
+    // second case handles decimals
+    if (((k & CC_DIGIT) && (prevSep || prevHL == HL_NUMBER)) ||
+        (c == '.' && prevHL == HL_NUMBER)) {
+      hl[i] = HL_NUMBER;
+
+      // we're in the middle of highlighting a sequence, so we increment/continue
+      i++;
+      prevSep = 0;
+      continue;
     }
 
     // hl keywords
     if (prevSep) {
-      int j;
-      for (j = 0; keywords[j]; j++) {
-        int kLen = strlen(keywords[j]);
-        int kw2 = keywords[j][kLen - 1] == '|';
-        if (kw2) kLen--;
-
-        if (!strncmp(&row->render[i], keywords[j], kLen) &&
-            isSep(row->render[i + kLen])) {
-          memset(&row->hl[i], kw2 ? HL_KEYWORD2 : HL_KEYWORD1, kLen);
-          i += kLen;
-          break;
-        }
-      }
-
-      if (keywords[j] == NULL) {
+      edKeyword *kw = hlKeyword(kt, cc, &s[i], len - i);
+      if (kw) {
+        memset(&hl[i], kw->hl, kw->len);
+        i += kw->len;
+      } else {
         prevSep = 0;
         continue;
       }
     }
 
-    prevSep = isSep(c);
+    prevSep = k & CC_SEP;
     i++;
   }
 
-  // check if we're still in a ml comment or not
-  int changed = (row->hlOpenComment != inComment);
-  row->hlOpenComment = inComment;
+  return inComment;
+}
 
-  // if we are not, change the highlighting of the next line
-  if (changed && row->rowInd + 1 < E.nRows)
-    edUpdateHL(&E.row[row->rowInd + 1]);
+static unsigned char *hlScratch(int len) {
+  // a class per char for one row, before it's packed into runs. only used
+  // with the lock held
+  static unsigned char *scratch = NULL;
+  static int scratchCap = 0;
+  if (len > scratchCap) {
+    scratchCap = len * 2;
+    scratch = realloc(scratch, scratchCap);
+  }
+  return scratch;
+}
+
+static void hlPack(edRow *row, const unsigned char *hl) {
+  // turns a class per char into the row's runs. a row that's all plain
+  // doesn't need any
+  static edHLRun *runs = NULL;
+  static int runsCap = 0;
+  if (row->size > runsCap) {
+    runsCap = row->size * 2;
+    runs = realloc(runs, sizeof(edHLRun) * runsCap);
+  }
+
+  int n = 0;
+  int j = 0;
+  while (j < row->size) {
+    int k = j + 1;
+    while (k < row->size && hl[k] == hl[j] && k - j < HL_RUN_MAX) k++;
+    runs[n++] = HL_RUN(hl[j], k - j);
+    j = k;
+  }
+  if (n == 0 || (n == 1 && hl[0] == HL_NORMAL)) {
+    edRowMemFree(row->hl, sizeof(edHLRun) * row->nHL);
+    row->hl = NULL;
+    row->nHL = 0;
+    return;
+  }
+
+  row->hl = edRowMemResize(row->hl, sizeof(edHLRun) * row->nHL, sizeof(edHLRun) * n);
+  row->nHL = n;
+  memcpy(row->hl, runs, sizeof(edHLRun) * n);
+}
+
+static int hlLexLazy(int at, int inComment) {
+  // only the end state of a row that isn't built is needed
+  int len;
+  char *s = edRowChars(at, &len);
+  return hlLex(E.syntax, s, len, inComment, hlScratch(len));
+}
+
+static int hlEndState(int at) {
+  // whether row at was last seen ending inside a ml comment
+  if (at < 0) return 0;
+
+  int start;
+  edRowBlock *blk = edRowBlockOf(at, &start);
+  if (blk->rows) return blk->rows[at - start].hlOpenComment;
+  if (at == start + blk->n - 1) return blk->hlOpen;
+
+  // lazy blocks only keep the state of their last row
+  int state = hlEndState(start - 1);
+  int i;
+  for (i = start; i <= at; i++) state = hlLexLazy(i, state);
+  return state;
+}
+
+static void hlInvalidate(int from, int to) {
+  // rows from on need redoing, and none before to can be trusted to converge.
+  // nothing past hlKnown is trusted anyway
+  if (from < E.hlValid) E.hlValid = from;
+  if (to > E.hlKnown) to = E.hlKnown;
+  if (to > E.hlBreak) E.hlBreak = to;
+  E.hlVersion++;
+}
+
+void edUpdateHL(edRow *row) {
+  // the row's text changed. it stays plain until it's lexed again
+  edRowMemFree(row->hl, sizeof(edHLRun) * row->nHL);
+  row->hl = NULL;
+  row->nHL = 0;
+
+  int at = edRowIndex(row);
+  hlInvalidate(at, at);
+}
+
+void edHLBuildBlock(edRowBlock *blk, int start) {
+  // the rows of a lazy block were just built. they're highlighted from the
+  // state the block was last run through with, which keeps them in line with
+  // the rows below unless the block now ends differently
+  int state = (start < E.hlKnown) ? hlEndState(start - 1) : 0;
+  int i;
+  for (i = 0; i < blk->n; i++) {
+    edRow *row = &blk->rows[i];
+    unsigned char *hl = hlScratch(row->size);
+    state = hlLex(E.syntax, row->chars, row->size, state, hl);
+    hlPack(row, hl);
+    row->hlOpenComment = state;
+  }
+
+  // a slice being lexed may have taken these rows as lazy
+  E.hlVersion++;
+
+  int end = start + blk->n;
+  if (start < E.hlKnown && state != blk->hlOpen) hlInvalidate(end, end);
+}
+
+void edHLInsert(int at, int n) {
+  // shift the marks past at, then treat the n new rows as edited. the row
+  // below them has a new neighbour, so that one has to be looked at too
+  if (at < E.hlKnown) {
+    E.hlKnown += n;
+    if (E.hlBreak >= at) E.hlBreak += n;
+  }
+  hlInvalidate(at, at + n);
+}
+
+void edHLDelete(int at) {
+  // the row that moved up into at now follows a different row
+  if (at < E.hlKnown) {
+    E.hlKnown--;
+    if (E.hlBreak > at) E.hlBreak--;
+  }
+  hlInvalidate(at, at);
+}
+
+/*** slices ***/
+// a run of rows from hlValid on, lexed in one go. they're redone until, past
+// the last edit, one ends in the same state as before: the rows after it are
+// still right, so the work follows the edit, not the size of the file
+typedef struct hlSliceRow {
+  const char *s; // the row's chars
+  int len;
+  size_t off; // where its highlighting goes in hlSlice.hl
+  int old; // the state it ended in so far, -1 if that isn't kept
+  int end; // the state it ends in now
+} hlSliceRow;
+
+typedef struct hlSlice {
+  struct edSyntax *syntax;
+  unsigned int version; // E.hlVersion when taken
+  int from;
+  int state; // going into row from
+  int brk, known; // E.hlBreak and E.hlKnown when taken
+  hlSliceRow *rows;
+  int n, cap;
+  int done; // rows lexed
+  int converged;
+  unsigned char *hl; // all the rows' highlighting, back to back
+  size_t bytes, hlCap;
+  char *text; // the worker's own copy of the rows' text
+  size_t textCap;
+} hlSlice;
+
+static void hlSliceTake(hlSlice *sl, int end, size_t budget) {
+  // rows from hlValid up to end, until their text adds up to budget. lazy
+  // blocks go in whole, since only their last row's state is kept
+  sl->syntax = E.syntax;
+  sl->version = E.hlVersion;
+  sl->from = E.hlValid;
+  sl->state = hlEndState(sl->from - 1);
+  sl->brk = E.hlBreak;
+  sl->known = E.hlKnown;
+  sl->n = 0;
+  sl->bytes = 0;
+
+  int at = sl->from;
+  while (at < end && sl->bytes < budget) {
+    int start;
+    edRowBlock *blk = edRowBlockOf(at, &start);
+    int stop = blk->rows ? at + 1 : start + blk->n;
+
+    for (; at < stop; at++) {
+      if (sl->n == sl->cap) {
+        sl->cap = sl->cap ? sl->cap * 2 : 1024;
+        sl->rows = realloc(sl->rows, sizeof(hlSliceRow) * sl->cap);
+      }
+      hlSliceRow *r = &sl->rows[sl->n++];
+
+      if (blk->rows) {
+        edRow *row = &blk->rows[at - start];
+        r->s = row->chars;
+        r->len = row->size;
+        r->old = row->hlOpenComment;
+      } else {
+        r->s = edRowChars(at, &r->len);
+        r->old = (at == start + blk->n - 1) ? blk->hlOpen : -1;
+      }
+      r->off = sl->bytes;
+      sl->bytes += r->len;
+    }
+  }
+
+  if (sl->bytes > sl->hlCap) {
+    sl->hlCap = sl->bytes * 2;
+    sl->hl = realloc(sl->hl, sl->hlCap);
+  }
+}
+
+static void hlSliceCopy(hlSlice *sl) {
+  // point the slice at a copy of its text, so it can be lexed unlocked
+  if (sl->bytes > sl->textCap) {
+    sl->textCap = sl->bytes * 2;
+    sl->text = realloc(sl->text, sl->textCap);
+  }
+
+  int k;
+  for (k = 0; k < sl->n; k++) {
+    hlSliceRow *r = &sl->rows[k];
+    memcpy(&sl->text[r->off], r->s, r->len);
+    r->s = &sl->text[r->off];
+  }
+}
+
+static void hlSliceLex(hlSlice *sl) {
+  int state = sl->state;
+  int k;
+  sl->converged = 0;
+  for (k = 0; k < sl->n; k++) {
+    hlSliceRow *r = &sl->rows[k];
+    state = hlLex(sl->syntax, r->s, r->len, state, &sl->hl[r->off]);
+    r->end = state;
+
+    // rows up to hlKnown were all worked out from the one before them
+    int at = sl->from + k;
+    if (r->old >= 0 && at >= sl->brk && at + 1 < sl->known && state == r->old) {
+      sl->converged = 1;
+      k++;
+      break;
+    }
+  }
+  sl->done = k;
+}
+
+static void hlSlicePut(hlSlice *sl) {
+  // hand the results over to the rows. only valid while E.hlVersion hasn't
+  // moved on from sl->version
+  int k;
+  for (k = 0; k < sl->done; k++) {
+    hlSliceRow *r = &sl->rows[k];
+    int start;
+    int at = sl->from + k;
+    edRowBlock *blk = edRowBlockOf(at, &start);
+
+    if (blk->rows) {
+      edRow *row = &blk->rows[at - start];
+      hlPack(row, &sl->hl[r->off]);
+      row->hlOpenComment = r->end;
+    } else if (at == start + blk->n - 1) {
+      blk->hlOpen = r->end;
+    }
+  }
+
+  int at = sl->converged ? E.hlKnown : sl->from + sl->done;
+  E.hlValid = at;
+  if (at > E.hlKnown) E.hlKnown = at;
+  if (at > E.hlBreak) E.hlBreak = 0;
+  E.hlVersion++;
+}
+
+int edHLAdvance(int end, size_t budget) {
+  // highlights rows [0, end) right here, if that takes at most budget bytes of
+  // text. if it won't, nothing's done and it's all left to the worker.
+  // returns whether the rows are done
+  static hlSlice sl;
+  if (end > E.nRows) end = E.nRows;
+
+  while (E.hlValid < end) {
+    size_t want = budget < HL_SLICE_BYTES ? budget : HL_SLICE_BYTES;
+    hlSliceTake(&sl, end, want);
+    if (sl.n == 0 || (want == budget && sl.from + sl.n < end)) return 0;
+
+    hlSliceLex(&sl);
+    hlSlicePut(&sl);
+    budget -= (sl.bytes < budget) ? sl.bytes : budget;
+  }
+  return 1;
+}
+
+void edHLEnsure(int end) {
+  // makes rows [0, end) correctly highlighted, however long that takes
+  edHLAdvance(end, (size_t)-1);
+}
+
+/*** background highlighting ***/
+static pthread_cond_t hlWork = PTHREAD_COND_INITIALIZER;
+static int hlWake[2] = {-1, -1};
+
+static void *hlWorker(void *unused) {
+  // works through the rest of the file a slice at a time. the text is copied
+  // out under the lock and lexed without it; the results are only put back
+  // if no row changed in the meantime
+  (void)unused;
+  hlSlice sl;
+  memset(&sl, 0, sizeof(sl));
+
+#ifdef SCHED_IDLE
+  // only ever use the cpu when nothing else wants it
+  struct sched_param sp = {0};
+  pthread_setschedparam(pthread_self(), SCHED_IDLE, &sp);
+#endif
+
+  pthread_mutex_lock(&E.lock);
+  while (1) {
+    while (E.syntax == NULL || E.hlValid >= E.nRows)
+      pthread_cond_wait(&hlWork, &E.lock);
+
+    hlSliceTake(&sl, E.nRows, HL_SLICE_BYTES);
+    hlSliceCopy(&sl);
+    pthread_mutex_unlock(&E.lock);
+
+    hlSliceLex(&sl);
+
+    pthread_mutex_lock(&E.lock);
+    if (E.hlVersion != sl.version) continue;
+
+    int from = sl.from;
+    hlSlicePut(&sl);
+
+    // rows on screen were drawn plain, so get the main thread to repaint
+    if (from < E.rowOff + E.sRows && E.hlValid > E.rowOff) edWakeMain();
+  }
+  return NULL;
+}
+
+void edHLStart() {
+  // the main thread holds the lock from here on, except while it waits for
+  // input (see edReadKey)
+  pthread_mutex_init(&E.lock, NULL);
+  pthread_mutex_lock(&E.lock);
+
+  if (pipe(hlWake) == -1) return;
+  fcntl(hlWake[0], F_SETFL, O_NONBLOCK);
+  fcntl(hlWake[1], F_SETFL, O_NONBLOCK);
+
+  pthread_t t;
+  if (pthread_create(&t, NULL, hlWorker, NULL) == 0) pthread_detach(t);
+}
+
+void edHLKick() {
+  // called with the lock held, right before it's let go of
+  if (E.syntax && E.hlValid < E.nRows) pthread_cond_signal(&hlWork);
+}
+
+int edHLWakeFd() {
+  return hlWake[0];
+}
+
+void edWakeMain() {
+  // gets the main thread to repaint, from another thread (the saver uses it
+  // too). if the pipe is full, a repaint is on its way anyway
+  if (write(hlWake[1], "", 1) == -1) {}
 }
 
 void edChooseHL() {
   E.syntax = NULL;
+
+  // everything gets highlighted again
+  E.hlValid = 0;
+  E.hlKnown = 0;
+  E.hlBreak = 0;
+  E.hlVersion++;
+
   if (E.fname == NULL) return;
 
   char *ext = strrchr(E.fname, '.');
@@ -204,11 +620,9 @@ void edChooseHL() {
       if ((isExt && ext && !strcmp(ext, s->fMatch[i])) ||
           (!isExt && strstr(E.fname, s->fMatch[i]))) {
         E.syntax = s;
-
-        // change the higlighting when the ftype changes
-        int fRow;
-        for (fRow = 0; fRow < E.nRows; fRow++) {
-          edUpdateHL(&E.row[fRow]);
+        if (s->kwTable == NULL) {
+          s->kwTable = hlCompileKeywords(s->keywords);
+          s->charClass = hlCompileClasses(s);
         }
         return;
       }
@@ -1,16 +1,59 @@
 #ifndef SYNTAX_HIGHLIGHTING_H_
 #define SYNTAX_HIGHLIGHTING_H_
 
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
 
 #include "constants.h"
 #include "row.h"
+#include "row_mem.h"
 #include "editor_configs.h"
 
+// text highlighted per slice by the worker, and per frame on the main thread
+#define HL_SLICE_BYTES (256 << 10)
+#define HL_SYNC_BYTES (64 << 10)
+
+// what a byte can be to the lexer of a syntax, see edSyntax.charClass
+#define CC_SEP (1 << 0)
+#define CC_DIGIT (1 << 1) // only if the syntax highlights numbers
+#define CC_QUOTE (1 << 2) // only if it highlights strings
+#define CC_COMMENT (1 << 3) // first byte of the sl comment token
+#define CC_MCOMMENT (1 << 4) // of the ml comment start token
+#define CC_MCOMMENT_END (1 << 5) // of the ml comment end token
+
+// a syntax's keywords in an open addressing hash table keyed by the whole
+// word, so matching one hashes the word at most once, whatever their number
+typedef struct edKeyword {
+  const char *s;
+  int len;
+  unsigned char hl;
+} edKeyword;
+
+typedef struct edKeywordTable {
+  edKeyword *slots;
+  unsigned int mask; // slot count - 1
+  int maxLen;
+} edKeywordTable;
 
 void edUpdateHL(edRow *row);
+void edHLBuildBlock(edRowBlock *blk, int start);
+void edHLInsert(int at, int n);
+void edHLDelete(int at);
+int edHLAdvance(int end, size_t budget);
+void edHLEnsure(int end);
+void edHLStart();
+void edHLKick();
+int edHLWakeFd();
+void edWakeMain();
 int edSyntaxToColor(int hl);
 void edChooseHL();
 int isSep(int c);
@@ -8,6 +8,7 @@ void error_exit(const char* s) {
 }
 
 void disableRawMode() {
+  write(STDOUT_FILENO, "\x1b[?2004l", 8);
   if (tcsetattr(STDIN_FILENO, TCSAFLUSH, &E.orig_termios) == -1)
     error_exit("tcsetattr");
 }
@@ -53,64 +54,254 @@ void enableRawMode() {
   */
   raw.c_lflag &= ~(ECHO | ICANON | IEXTEN | ISIG);
 
-  // introduce timeouts on read
+  // reads never wait; waiting on input is done with poll
   raw.c_cc[VMIN] = 0; // # bytes before returning
-  raw.c_cc[VTIME] = 1; // 100 ms before read returns
+  raw.c_cc[VTIME] = 0; // no timeout either
 
   // TCSAFLUSH means set only after all output is written to the terminal
   if(tcsetattr(STDIN_FILENO, TCSAFLUSH, &raw) == -1)
     error_exit("tcsetattr");
+
+  // have pastes marked, so they can go in all at once
+  write(STDOUT_FILENO, "\x1b[?2004h", 8);
 }
 
-int edReadKey() {
-  int r;
-  char c;
-  while ((r = read(STDIN_FILENO, &c, sizeof(char))) != 1) {
-    if (r == -1 && errno != EAGAIN)
-      error_exit("read");
+// input read off stdin but not taken yet, in a ring. a paste comes in a few
+// big reads instead of a read per char, and a read can hold many keys
+static char in[INPUT_RING];
+static unsigned int inHead = 0; // taken up to here
+static unsigned int inTail = 0; // read up to here
+
+#define IN_LEN (inTail - inHead)
+#define IN_AT(i) (in[(inHead + (i)) & (INPUT_RING - 1)])
+
+static int inRead(int ms) {
+  // reads what's come in, waiting up to ms for it (-1 for as long as it
+  // takes). returns how many bytes that was
+  struct pollfd fd = {STDIN_FILENO, POLLIN, 0};
+  if (IN_LEN == INPUT_RING) return 0;
+  if (poll(&fd, 1, ms) != 1 || !(fd.revents & POLLIN)) return 0;
+
+  // the free part of the ring may wrap; what's past the wrap is left for
+  // the next read
+  unsigned int at = inTail & (INPUT_RING - 1);
+  unsigned int n = INPUT_RING - IN_LEN;
+  if (n > INPUT_RING - at) n = INPUT_RING - at;
+  int r = read(STDIN_FILENO, &in[at], n);
+  if (r == -1 && errno != EAGAIN && errno != EINTR) error_exit("read");
+  if (r <= 0) return 0;
+  inTail += r;
+  return r;
+}
+
+static int csiKey(int final, int n) {
+  // the key for "ESC [ n final"
+  switch (final) {
+    case 'A': return ARROW_UP;
+    case 'B': return ARROW_DOWN;
+    case 'C': return ARROW_RIGHT;
+    case 'D': return ARROW_LEFT;
+    case 'H': return HOME_KEY;
+    case 'F': return END_KEY;
+    case '~':
+      switch (n) {
+        case 1: return HOME_KEY;
+        case 3: return DEL_KEY;
+        case 4: return END_KEY;
+        case 5: return PAGE_UP;
+        case 6: return PAGE_DOWN;
+        case 7: return HOME_KEY;
+        case 8: return END_KEY;
+        case 200: return PASTE_START;
+        case 201: return PASTE_END;
+      }
+  }
+  return '\x1b';
+}
+
+static int ss3Key(int final) {
+  // the key for "ESC O final"
+  switch (final) {
+    case 'A': return ARROW_UP;
+    case 'B': return ARROW_DOWN;
+    case 'C': return ARROW_RIGHT;
+    case 'D': return ARROW_LEFT;
+    case 'H': return HOME_KEY;
+    case 'F': return END_KEY;
   }
+  return '\x1b';
+}
 
-  if (c == '\x1b') {
-    char seq[3];
-
-    // check to see if esc. sequence or just esc.
-    if (read(STDIN_FILENO, &seq[0], 1) != 1) return '\x1b';
-    if (read(STDIN_FILENO, &seq[1], 1) != 1) return '\x1b';
-
-    if (seq[0] == '[') {
-      if (seq[1] >= '0' && seq[1] <= '9') {
-        if (read(STDIN_FILENO, &seq[2], 1) != 1) return '\x1b';
-        if (seq[2] == '~') {
-          switch (seq[1]) {
-            case '1': return HOME_KEY;
-            case '3': return DEL_KEY;
-            case '4': return END_KEY;
-            case '5': return PAGE_UP;
-            case '6': return PAGE_DOWN;
-            case '7': return HOME_KEY;
-            case '8': return END_KEY;
-          }
+static int parseKey(int *key, int whole) {
+  // takes the next key off the ring, if the bytes for all of it are there.
+  // if they stop partway through an escape sequence and whole is set, they're
+  // all there's going to be, and they're taken as a bare ESC
+  enum { GROUND, ESC, CSI, SS3 } state = GROUND;
+  int n = 0;     // first number in a CSI sequence
+  int more = 0;  // past the first number
+  unsigned int i;
+  for (i = 0; i < IN_LEN; i++) {
+    unsigned char c = IN_AT(i);
+    switch (state) {
+      case GROUND:
+        if (c != '\x1b') {
+          *key = (char)c;
+          inHead++;
+          return 1;
         }
-      } else {
-        switch (seq[1]) {
-          case 'A': return ARROW_UP;
-          case 'B': return ARROW_DOWN;
-          case 'C': return ARROW_RIGHT;
-          case 'D': return ARROW_LEFT;
-          case 'H': return HOME_KEY;
-          case 'F': return END_KEY;
+        state = ESC;
+        break;
+
+      case ESC:
+        if (c == '[') {
+          state = CSI;
+        } else if (c == 'O') {
+          state = SS3;
+        } else {
+          // alt and a key comes in as ESC and the key; both are dropped.
+          // another ESC starts a key of its own
+          *key = '\x1b';
+          inHead += (c == '\x1b') ? 1 : 2;
+          return 1;
         }
-      }
-    } else if (seq[0] == 'O') {
-      switch (seq[1]) {
-        case 'H': return HOME_KEY;
-        case 'F': return END_KEY;
-      }
+        break;
+
+      case CSI:
+        // numbers and separators, up to the final byte
+        if (c >= '0' && c <= '9') {
+          if (!more && n < 1000) n = n * 10 + c - '0';
+        } else if (c >= 0x20 && c <= 0x3f) {
+          more = 1;
+        } else {
+          *key = csiKey(c, n);
+          inHead += i + 1;
+          return 1;
+        }
+        break;
+
+      case SS3:
+        *key = ss3Key(c);
+        inHead += i + 1;
+        return 1;
     }
+  }
 
-    return '\x1b';
-  } else {
-    return c;
+  if (i == 0 || !whole) return 0;
+  *key = '\x1b';
+  inHead += i;
+  return 1;
+}
+
+static int readKey() {
+  // wait on the keyboard, repainting whenever the hl worker has finished
+  // rows that are on screen
+  struct pollfd fds[2] = {{STDIN_FILENO, POLLIN, 0}, {edHLWakeFd(), POLLIN, 0}};
+  int key;
+  while (!parseKey(&key, 0)) {
+    if (IN_LEN > 0) {
+      // the start of an escape sequence. the rest of one comes right behind
+      // it, so if nothing does for a moment it was the ESC key
+      if (inRead(ESC_WAIT_MS)) continue;
+      parseKey(&key, 1);
+      return key;
+    }
+
+    if (poll(fds, 2, -1) == -1) {
+      if (errno == EINTR) continue;
+      error_exit("poll");
+    }
+
+    if (fds[1].revents & POLLIN) {
+      char drain[64];
+      while (read(fds[1].fd, drain, sizeof(drain)) > 0);
+      pthread_mutex_lock(&E.lock);
+      edRefreshScreen();
+      pthread_mutex_unlock(&E.lock);
+    }
+
+    if (fds[0].revents & POLLIN) inRead(0);
+  }
+  return key;
+}
+
+int edReadKey() {
+  // the document is only left to the hl worker while we wait on the user
+  edHLKick();
+  pthread_mutex_unlock(&E.lock);
+  int c = readKey();
+  pthread_mutex_lock(&E.lock);
+  return c;
+}
+
+int edKeysPending(int ms) {
+  // whether there's input in for edReadKey to take, waiting up to ms for
+  // some. the document is left to the hl worker while it waits
+  if (IN_LEN > 0) return 1;
+  if (ms <= 0) return inRead(0) > 0;
+
+  pthread_mutex_unlock(&E.lock);
+  int r = inRead(ms);
+  pthread_mutex_lock(&E.lock);
+  return r > 0;
+}
+
+int edIsTextKey(int c) {
+  // keys that go into the text as they are. bytes past ascii may come out of
+  // readKey negative
+  return c == '\t' || (c >= ' ' && c < 256 && c != BACKSPACE) || (c < 0 && c >= -128);
+}
+
+int edReadSpan(char *s, int max) {
+  // takes up to max text keys that are already waiting, without waiting for
+  // any more. stops short of anything else, which is left to edReadKey
+  int n = 0;
+  while (n < max) {
+    if (IN_LEN == 0 && !inRead(0)) break;
+
+    unsigned char c = IN_AT(0);
+    if (c != '\t' && (c < ' ' || c == BACKSPACE)) break;
+    s[n++] = c;
+    inHead++;
+  }
+  return n;
+}
+
+void edReadPaste(str *db) {
+  // appends the rest of a bracketed paste, up to the marker ending it. the
+  // terminal sends it all at once, so if nothing comes for a while it's taken
+  // to be over anyway
+  static const char end[] = "\x1b[201~";
+  int matched = 0; // of end
+  while (matched < (int)sizeof(end) - 1) {
+    if (IN_LEN == 0 && !inRead(PASTE_WAIT_MS)) {
+      // what looked like the start of the end marker is part of the paste
+      dbAppend(db, end, matched);
+      return;
+    }
+
+    if (matched == 0) {
+      // everything up to the next escape goes in as it is, up to where the
+      // ring wraps at a time
+      char *p = &IN_AT(0);
+      unsigned int n = INPUT_RING - (inHead & (INPUT_RING - 1));
+      if (n > IN_LEN) n = IN_LEN;
+      char *esc = memchr(p, '\x1b', n);
+      if (esc) n = esc - p;
+      dbAppend(db, p, n);
+      inHead += n;
+      if (esc == NULL) continue;
+    }
+
+    char c = IN_AT(0);
+    inHead++;
+    if (c == end[matched]) {
+      matched++;
+    } else {
+      // that wasn't the end after all
+      dbAppend(db, end, matched);
+      matched = (c == end[0]);
+      if (!matched) dbAppendChar(db, c);
+    }
   }
 }
 
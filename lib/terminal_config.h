@@ -2,6 +2,8 @@
 #define TERMINAL_CONFIG_H_
 
 #include <errno.h>
+#include <poll.h>
+#include <pthread.h>
 #include <unistd.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -12,11 +14,27 @@
 #include "editor_configs.h"
 #include "editor_output.h"
 
+// bytes of input held before it's taken (a power of two)
+#define INPUT_RING (1 << 16)
+
+// the most typed in as one span
+#define INPUT_BUF 4096
+
+// how long the rest of an escape sequence may take to come in after the ESC
+#define ESC_WAIT_MS 20
+
+// how long a paste may stall before it's given up on
+#define PASTE_WAIT_MS 1000
+
 
 void error_exit(const char *s);
 void enableRawMode();
 void disableRawMode();
 int edReadKey();
+int edKeysPending(int ms);
+int edIsTextKey(int c);
+int edReadSpan(char *s, int max);
+void edReadPaste(str *db);
 int getWindowSize(int *rows, int *cols);
 
 #endif // TERMINAL_CONFIG_H_
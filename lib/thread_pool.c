@@ -0,0 +1,83 @@
+#include "thread_pool.h"
+
+static struct {
+  pthread_mutex_t lock;
+  pthread_cond_t work; // a new job was posted
+  pthread_cond_t done; // the last task of a job finished
+  int nThreads; // -1 until the pool is started
+
+  edTask fn;
+  void *arg;
+  int nTasks;
+  int next; // next task to hand out
+  int pending; // tasks not finished yet
+  unsigned long job; // bumped for every job, so workers can tell them apart
+} pool = {PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER,
+          PTHREAD_COND_INITIALIZER, -1, NULL, NULL, 0, 0, 0, 0};
+
+static void poolDrain() {
+  // run tasks of the current job until none are left. called with the lock held
+  while (pool.next < pool.nTasks) {
+    int i = pool.next++;
+    pthread_mutex_unlock(&pool.lock);
+    pool.fn(pool.arg, i);
+    pthread_mutex_lock(&pool.lock);
+
+    if (--pool.pending == 0) pthread_cond_broadcast(&pool.done);
+  }
+}
+
+static void *poolWorker(void *unused) {
+  (void)unused;
+  unsigned long seen = 0;
+
+  pthread_mutex_lock(&pool.lock);
+  while (1) {
+    while (pool.job == seen) pthread_cond_wait(&pool.work, &pool.lock);
+    seen = pool.job;
+    poolDrain();
+  }
+  return NULL;
+}
+
+static void poolStart() {
+  long cores = sysconf(_SC_NPROCESSORS_ONLN);
+  if (cores > POOL_MAX_THREADS) cores = POOL_MAX_THREADS;
+
+  // the caller is one of the threads doing the work
+  pool.nThreads = 0;
+  int i;
+  for (i = 1; i < cores; i++) {
+    pthread_t t;
+    if (pthread_create(&t, NULL, poolWorker, NULL) != 0) break;
+    pthread_detach(t);
+    pool.nThreads++;
+  }
+}
+
+int edPoolSize() {
+  pthread_mutex_lock(&pool.lock);
+  if (pool.nThreads == -1) poolStart();
+  int n = pool.nThreads + 1;
+  pthread_mutex_unlock(&pool.lock);
+  return n;
+}
+
+void edPoolRun(edTask fn, void *arg, int nTasks) {
+  if (nTasks <= 0) return;
+
+  pthread_mutex_lock(&pool.lock);
+  if (pool.nThreads == -1) poolStart();
+
+  pool.fn = fn;
+  pool.arg = arg;
+  pool.nTasks = nTasks;
+  pool.next = 0;
+  pool.pending = nTasks;
+  pool.job++;
+  pthread_cond_broadcast(&pool.work);
+
+  poolDrain();
+  while (pool.pending > 0) pthread_cond_wait(&pool.done, &pool.lock);
+  pthread_mutex_unlock(&pool.lock);
+}
@@ -0,0 +1,22 @@
+#ifndef THREAD_POOL_H_
+#define THREAD_POOL_H_
+
+#ifndef _DEFAULT_SOURCE
+#define _DEFAULT_SOURCE
+#endif
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+// upper bound on worker threads, whatever the core count
+#define POOL_MAX_THREADS 16
+
+typedef void (*edTask)(void *arg, int i);
+
+// runs fn(arg, i) for every i in [0, nTasks) on the pool and waits for all
+// of them. the calling thread helps out, so this also works with no workers.
+void edPoolRun(edTask fn, void *arg, int nTasks);
+int edPoolSize();
+
+#endif // THREAD_POOL_H_
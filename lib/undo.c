@@ -0,0 +1,311 @@
+#include "undo.h"
+#include "editor_output.h"
+#include "row_operations.h"
+
+// every group of records starts with one of these. its row and col are where
+// the cursor was before the group, and its text is where it was after
+#define UNDO_GROUP 'g'
+
+// a change made to the rows: one of the JOURNAL_ ops, with what it takes to
+// make it again and to take it back. len bytes of text follow it: what went
+// in, or what went
+typedef struct edUndoRec {
+  unsigned char op;
+  unsigned char back; // a run of backspaces: its text is stored right to left
+  int row;
+  int col; // JOURNAL_LINES: how many rows went in
+  int len;
+  unsigned int prev; // bytes back to the record before, 0 for the first
+} edUndoRec;
+
+#define REC_SIZE(len) (sizeof(edUndoRec) + (((size_t)(len) + 3) & ~(size_t)3))
+#define REC(off) ((edUndoRec *)&u.b[off])
+
+// the log: records one after another in a buffer that's only ever added to
+// at the top, up to max. undo moves top down past a group, redo moves it back
+// up, and a new record drops what was undone. guarded by E.lock
+static struct {
+  char *b;
+  size_t cap; // allocated
+  size_t max;
+  size_t top; // records below here are done
+  size_t end; // records from top to here were undone, and can be redone
+  size_t last; // the record right below top
+  size_t group; // the group going on
+  int grouped; // is there a group going on?
+  int lost; // it didn't fit, and the rest of it isn't kept either
+  int kind; // of the key that started it
+  int cY, cX; // the cursor before the next group
+  int replaying; // undoing or redoing, which isn't recorded
+} u = {NULL, 0, UNDO_LOG_MAX, 0, 0, 0, 0, 0, 0, UNDO_OTHER, 0, 0, 0};
+
+static void drop(size_t want) {
+  // drops whole groups off the bottom: at least want bytes of them, and a
+  // quarter of max on top of that so it isn't done again for a while. the
+  // group going on stays
+  size_t bound = u.grouped ? u.group : u.top;
+  size_t target = want + u.max / 4;
+  size_t cut = 0, off = 0;
+  while (off < bound && cut < target) {
+    off += REC_SIZE(REC(off)->len);
+    if (off == bound || REC(off)->op == UNDO_GROUP) cut = off;
+  }
+  if (cut == 0) return;
+
+  memmove(u.b, &u.b[cut], u.end - cut);
+  u.top -= cut;
+  u.end -= cut;
+  u.last = u.last > cut ? u.last - cut : 0;
+  u.group = u.group > cut ? u.group - cut : 0;
+  if (u.end > 0) REC(0)->prev = 0;
+}
+
+static int reserve(size_t need) {
+  // room for need more bytes at the top. 0 if there isn't, even with every
+  // group but the one going on gone
+  u.end = u.top;
+  if (u.top + need > u.max) drop(u.top + need - u.max);
+  if (u.top + need > u.max) return 0;
+
+  if (u.top + need > u.cap) {
+    size_t cap = u.cap ? u.cap * 2 : 4096;
+    if (cap < u.top + need) cap = u.top + need;
+    if (cap > u.max) cap = u.max;
+    char *b = realloc(u.b, cap);
+    if (b == NULL) return 0;
+    u.b = b;
+    u.cap = cap;
+  }
+  return 1;
+}
+
+static edUndoRec *push(int op, int row, int col, int len) {
+  // a new record at the top, with room for len bytes of text. NULL if it
+  // doesn't fit
+  size_t size = REC_SIZE(len);
+  if (!reserve(size)) return NULL;
+
+  edUndoRec *r = REC(u.top);
+  r->op = op;
+  r->back = 0;
+  r->row = row;
+  r->col = col;
+  r->len = len;
+  r->prev = u.top ? u.top - u.last : 0;
+  u.last = u.top;
+  u.top += size;
+  u.end = u.top;
+  return r;
+}
+
+static void groupEnd() {
+  // the group going on is over, and a redo of it leaves the cursor here
+  if (u.grouped && !u.lost) {
+    int *after = (int *)(REC(u.group) + 1);
+    after[0] = E.cY;
+    after[1] = E.cX;
+  }
+  u.grouped = 0;
+}
+
+void edUndoGroup(int kind) {
+  // called for each key before it's handled
+  if (kind == UNDO_OTHER || kind != u.kind) groupEnd();
+  if (!u.grouped) {
+    u.cY = E.cY;
+    u.cX = E.cX;
+  }
+  u.kind = kind;
+}
+
+int edUndoOn() {
+  return !u.replaying;
+}
+
+static int coalesce(int op, int row, int col, const char *s, size_t len) {
+  // typing into a row goes onto the record of the chars typed before it, and
+  // so do backspaces (and deletes) onto the record of the ones before them
+  edUndoRec *r = REC(u.last);
+  if (r->op != op || r->row != row) return 0;
+
+  int back;
+  if (op == JOURNAL_INSERT && col == r->col + r->len) back = 0;
+  else if (op == JOURNAL_REMOVE && !r->back && col == r->col) back = 0;
+  else if (op == JOURNAL_REMOVE && len == 1 && col + 1 == r->col && (r->back || r->len == 1)) back = 1;
+  else return 0;
+
+  size_t grow = REC_SIZE(r->len + len) - REC_SIZE(r->len);
+  if (!reserve(grow)) return 0;
+  r = REC(u.last);
+  memcpy((char *)(r + 1) + r->len, s, len);
+  r->len += len;
+  r->back = back;
+  if (back) r->col = col;
+  u.top += grow;
+  u.end = u.top;
+  return 1;
+}
+
+void edUndoRecord(int op, int row, int col, const char *s, size_t len) {
+  // records a change to the rows. s is the text that went in, or that's
+  // about to go. what was undone can't be redone after it
+  if (u.replaying) return;
+  u.end = u.top;
+  if (!u.grouped) {
+    u.grouped = 1;
+    u.lost = 0;
+    edUndoRec *g = push(UNDO_GROUP, u.cY, u.cX, 2 * sizeof(int));
+    if (g == NULL) {
+      u.lost = 1;
+      return;
+    }
+    int *after = (int *)(g + 1);
+    after[0] = u.cY;
+    after[1] = u.cX;
+    u.group = u.last;
+  } else if (u.lost || coalesce(op, row, col, s, len)) {
+    return;
+  }
+
+  edUndoRec *r = push(op, row, col, len);
+  if (r == NULL) {
+    // a group that's only partly there can't be undone, so it all goes
+    u.top = u.end = u.group;
+    u.last = u.group - REC(u.group)->prev;
+    u.lost = 1;
+    return;
+  }
+  memcpy(r + 1, s, len);
+}
+
+static void reverse(char *s, int len) {
+  int i;
+  for (i = 0; i < len / 2; i++) {
+    char c = s[i];
+    s[i] = s[len - 1 - i];
+    s[len - 1 - i] = c;
+  }
+}
+
+static void unapply(edUndoRec *r) {
+  char *s = (char *)(r + 1);
+  int i;
+  switch (r->op) {
+    case JOURNAL_INSERT:
+      edRowDeleteStr(edRowAt(r->row), r->col, r->len);
+      break;
+    case JOURNAL_REMOVE:
+    case JOURNAL_TRUNCATE:
+      // backspaces took the chars right to left. they're turned around to go
+      // back in, and then back again for the next undo
+      if (r->back) reverse(s, r->len);
+      edRowInsertStr(edRowAt(r->row), r->col, s, r->len);
+      if (r->back) reverse(s, r->len);
+      break;
+    case JOURNAL_ROW:
+      edDeleteRow(r->row);
+      break;
+    case JOURNAL_LINES:
+      for (i = 0; i < r->col; i++) edDeleteRow(r->row);
+      break;
+    case JOURNAL_DELETE:
+      edInsertRow(r->row, s, r->len);
+      break;
+  }
+}
+
+static void apply(edUndoRec *r) {
+  char *s = (char *)(r + 1);
+  switch (r->op) {
+    case JOURNAL_INSERT:
+      edRowInsertStr(edRowAt(r->row), r->col, s, r->len);
+      break;
+    case JOURNAL_REMOVE:
+      edRowDeleteStr(edRowAt(r->row), r->col, r->len);
+      break;
+    case JOURNAL_TRUNCATE:
+      edRowTruncate(edRowAt(r->row), r->col);
+      break;
+    case JOURNAL_ROW:
+      edInsertRow(r->row, s, r->len);
+      break;
+    case JOURNAL_LINES:
+      edInsertLines(r->row, s, r->len);
+      break;
+    case JOURNAL_DELETE:
+      edDeleteRow(r->row);
+      break;
+  }
+}
+
+static void moveTo(int y, int x) {
+  E.cY = y < E.nRows ? y : E.nRows;
+  int size = E.cY < E.nRows ? edRowRead(E.cY)->size : 0;
+  E.cX = x < size ? x : size;
+}
+
+int edUndo() {
+  // takes back the last group of changes, one record at a time from the
+  // last, and puts the cursor back where it was before them. 0 if there's
+  // none
+  groupEnd();
+  if (u.top == 0) {
+    edSetSMessage("Nothing to undo");
+    return 0;
+  }
+
+  u.replaying = 1;
+  edUndoRec *r;
+  do {
+    r = REC(u.last);
+    u.top = u.last;
+    u.last -= r->prev;
+    if (r->op != UNDO_GROUP) unapply(r);
+  } while (r->op != UNDO_GROUP);
+  u.replaying = 0;
+  moveTo(r->row, r->col);
+  return 1;
+}
+
+int edRedo() {
+  // makes the group of changes undone last again. 0 if there's none
+  groupEnd();
+  if (u.top == u.end) {
+    edSetSMessage("Nothing to redo");
+    return 0;
+  }
+
+  u.replaying = 1;
+  edUndoRec *g = REC(u.top);
+  do {
+    edUndoRec *r = REC(u.top);
+    if (r->op != UNDO_GROUP) apply(r);
+    u.last = u.top;
+    u.top += REC_SIZE(r->len);
+  } while (u.top < u.end && REC(u.top)->op != UNDO_GROUP);
+  u.replaying = 0;
+
+  int *after = (int *)(g + 1);
+  moveTo(after[0], after[1]);
+  return 1;
+}
+
+void edUndoClear() {
+  // a new document starts with nothing to undo
+  free(u.b);
+  u.b = NULL;
+  u.cap = u.top = u.end = u.last = u.group = 0;
+  u.grouped = u.lost = 0;
+}
+
+void edUndoSetMax(size_t max) {
+  // the most memory the log may take. what's past it goes
+  u.max = max;
+  u.end = u.top;
+  if (u.top > max) drop(u.top - max);
+  if (u.top > max) edUndoClear();
+}
+
+size_t edUndoSize() {
+  return u.end;
+}
@@ -0,0 +1,33 @@
+#ifndef UNDO_H_
+#define UNDO_H_
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "editor_configs.h"
+#include "journal.h"
+
+// the most memory the undo log takes by default. the oldest groups go to
+// make room past it, see edUndoSetMax
+#define UNDO_LOG_MAX (64 << 20)
+
+// what a key does, as far as grouping goes: a run of typed chars is undone
+// as one, and so is a run of backspaces. any other key starts a group of
+// its own
+enum edUndoKind {
+  UNDO_OTHER,
+  UNDO_TYPING,
+  UNDO_ERASING
+};
+
+
+void edUndoGroup(int kind);
+int edUndoOn();
+void edUndoRecord(int op, int row, int col, const char *s, size_t len);
+int edUndo();
+int edRedo();
+void edUndoClear();
+void edUndoSetMax(size_t max);
+size_t edUndoSize();
+
+#endif // UNDO_H_